@@ -0,0 +1,379 @@
+/*
+ *  World Generation Benchmark
+ *
+ *  Headless: generates the world and its boards for a fixed list of seeds,
+ *  reports per-stage timings and a content hash per board. Hashes can be
+ *  written to / checked against a golden file to prove that an optimisation
+ *  leaves generated output bit-identical.
+ *
+ *  With --regen, each world is then regenerated after a threshold change to
+ *  time a partial pipeline rerun (only classify and later stages run).
+ *
+ *  With --access, each board also runs tile access workloads: shortest
+ *  paths between free tiles and a renderer-style sweep of FOV windows. Run
+ *  with --layout rows and --layout blocks to compare storage layouts (the
+ *  workload checksums must match between layouts).
+ *
+ *  With --handles, the first board also checks NPC handles past the old
+ *  20-bit id space (see checkHandles).
+ *
+ *  Generation draws only raw mt19937 output (see rogrand), so golden hashes
+ *  don't depend on the standard library.
+ */
+
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+#include <map>
+#include <chrono>
+
+#include "rogrand.hh"
+#include "gameboard.hh"
+
+using namespace rogrand;
+
+// Fixed seed list (extend at the end only, golden files depend on the order)
+static const unsigned int benchSeeds[] = {
+    0x00000001, 0x00000002, 0x0000002A, 0x00000539,
+    0x00C0FFEE, 0xDEADBEEF, 0x8BADF00D, 0xFFFFFFFF };
+static const int numBenchSeeds = sizeof(benchSeeds)/sizeof(benchSeeds[0]);
+
+struct BoardResult {
+    unsigned int seed;
+    int          boardX;
+    int          boardY;
+    uint64_t     hash;
+};
+
+void printUsage( const char* prog )
+{
+    printf("Usage: %s [options]\n", prog);
+    printf("    --boards N          Boards to generate (default %d, cycles the seed list)\n", numBenchSeeds);
+    printf("    --world ROWS COLS   World dimensions in tiles    (default %d %d)\n", wRows, wCols);
+    printf("    --board ROWS COLS   Board dimensions in tiles    (default %d %d)\n", bRows, bCols);
+    printf("    --erode             Enable terrain erosion\n");
+    printf("    --regen             Time a rerun after a threshold change\n");
+    printf("    --access            Time pathfinding and render tile access per board\n");
+    printf("    --handles           Check NPC handles with more than 2^20 NPCs on a board\n");
+    printf("    --layout NAME       Tile storage layout: rows or blocks (default %s)\n", layoutNames[tileLayout]);
+    printf("    --write FILE        Write board hashes to a golden file\n");
+    printf("    --check FILE        Compare board hashes against a golden file\n"); fflush(stdout);
+}
+
+// One row of world stage timings
+void printTimes( const char* label, const GenTimes& gTimes )
+{
+    printf("%08x  %s", seed, label);
+    for (int iS=0; iS<MAX_STAGE; iS++) {
+        printf(" %8.3f", gTimes.stage[iS]); }
+    printf(" %8.3f\n", gTimes.autotile);
+}
+
+// Elapsed milliseconds since tStart
+double elapsedMs( std::chrono::steady_clock::time_point tStart )
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-tStart).count();
+}
+
+// Path workload: shortest paths between spread out free tiles. Returns the
+// total path length.
+static const int benchPaths = 16;
+uint64_t runPaths( Gameboard* brd )
+{
+    int numFree = brd->countFree();
+    if (numFree < 2) {
+        return 0; }
+
+    uint64_t pathLen = 0;
+    for (int iP=0; iP<benchPaths; iP++)
+    {
+        bLoc here  = brd->getFree((int)(((uint64_t)iP*2654435761u) % numFree));
+        bLoc there = brd->getFree((int)(((uint64_t)iP*2654435761u + numFree/2) % numFree));
+        pathLen += findPath(here, there, brd).size();
+    }
+    return pathLen;
+}
+
+// Render workload: read every tile of FOV windows stepped half a view
+// across the board, as Gamemaster::renderTile does. Returns a checksum.
+uint64_t runRender( Gameboard* brd )
+{
+    uint64_t sum = 0;
+    int stepR = std::max(1, vRows/2);
+    int stepC = std::max(1, vCols/2);
+    for (int wy=0; wy<brd->getRows(); wy+=stepR)
+    {
+        for (int wx=0; wx<brd->getCols(); wx+=stepC)
+        {
+            for (int jj=wy; jj<std::min(wy+vRows, brd->getRows()); jj++)
+            {
+                for (int ii=wx; ii<std::min(wx+vCols, brd->getCols()); ii++)
+                {
+                    Tile tTile = brd->getTile(jj,ii);
+                    sum += tTile.getElev();
+                    if (0 != tTile.getNbrMask()) {
+                        for (int iC=0; iC<MAX_IC; iC++) {
+                            sum += tTile.getCrnr(iC) << (iC+1); }
+                    }
+                    sum += tTile.hasOccupant();
+                }
+            }
+        }
+    }
+    return sum;
+}
+
+// Handle check: add more NPCs than a 20-bit id holds, reap some and add
+// more (reusing their ids). Every live handle must lead back to its slot
+// and every reaped one to -1. Returns the number of bad handles. Reaping
+// writes moved NPCs to the board's tiles, so run it after hashing.
+int checkHandles( Gameboard* brd )
+{
+    NPCStore npcs(brd);
+    int numAdd = (1<<20)+2;
+    for (int iN=0; iN<numAdd; iN++) {
+        npcs.add(iN%brd->getCols(), (iN/brd->getCols())%brd->getRows(), 'g', false, 0.0); }
+
+    // Kill a spread of NPCs as takeDmg does (few, as cells are crowded)
+    vector<NPCHandle> reaped;
+    for (int iN=0; iN<numAdd; iN+=4099)
+    {
+        npcs.lp[iN] = 0;
+        npcs.gridRmv(iN);
+        npcs.dead.push_back(npcs.handle[iN]);
+        reaped.push_back(npcs.handle[iN]);
+    }
+    npcs.reap();
+    for (size_t iR=0; iR<reaped.size(); iR++) {
+        npcs.add(0, 0, 'g', false, 0.0); }
+
+    int numBad = 0;
+    for (int iN=0; iN<npcs.size(); iN++) {
+        numBad += (npcs.slotOf(npcs.handle[iN]) != iN); }
+    for (size_t iR=0; iR<reaped.size(); iR++) {
+        numBad += (npcs.slotOf(reaped[iR]) >= 0); }
+    printf("INFO: %d NPC handles checked (%d reaped), %d bad\n", npcs.size(), (int)reaped.size(), numBad);
+    return numBad;
+}
+
+// Golden file lines: "seed boardX boardY hash" (hex seed and hash)
+bool readGolden( const string& fPath, map<string,uint64_t>& golden )
+{
+    FILE* fIn = fopen(fPath.c_str(), "r");
+    if (nullptr == fIn) {
+        printf("ERROR: Unable to read golden file %s\n", fPath.c_str());
+        return false;
+    }
+
+    unsigned int       gSeed;
+    int                gX, gY;
+    unsigned long long gHash;
+    char               gKey[64];
+    while (4 == fscanf(fIn, "%x %d %d %llx", &gSeed, &gX, &gY, &gHash)) {
+        snprintf(gKey, sizeof(gKey), "%08x %d %d", gSeed, gX, gY);
+        golden[gKey] = gHash;
+    }
+    fclose(fIn);
+    return true;
+}
+
+int main( int argc, char* args[] )
+{
+    int    numBoards = numBenchSeeds;
+    int    optWR = wRows, optWC = wCols;
+    int    optBR = bRows, optBC = bCols;
+    bool   optRegen = false;
+    bool   optAccess = false;
+    bool   optHandles = false;
+    int    numBadHandles = -1;      // -1 until checked
+    string writePath;
+    string checkPath;
+
+    for (int iArg=1; iArg<argc; iArg++)
+    {
+        string opt = args[iArg];
+        if ((opt=="--boards") && (iArg+1 < argc)) {
+            numBoards = atoi(args[++iArg]); }
+        else if ((opt=="--world") && (iArg+2 < argc)) {
+            optWR = atoi(args[++iArg]);
+            optWC = atoi(args[++iArg]); }
+        else if ((opt=="--board") && (iArg+2 < argc)) {
+            optBR = atoi(args[++iArg]);
+            optBC = atoi(args[++iArg]); }
+        else if (opt=="--erode") {
+            terrainParams.erosion.enabled = true; }
+        else if (opt=="--regen") {
+            optRegen = true; }
+        else if (opt=="--access") {
+            optAccess = true; }
+        else if (opt=="--handles") {
+            optHandles = true; }
+        else if ((opt=="--layout") && (iArg+1 < argc) && (string(args[iArg+1])==layoutNames[LAYOUT_ROWS])) {
+            tileLayout = LAYOUT_ROWS;
+            iArg++; }
+        else if ((opt=="--layout") && (iArg+1 < argc) && (string(args[iArg+1])==layoutNames[LAYOUT_BLOCKS])) {
+            tileLayout = LAYOUT_BLOCKS;
+            iArg++; }
+        else if ((opt=="--write") && (iArg+1 < argc)) {
+            writePath = args[++iArg]; }
+        else if ((opt=="--check") && (iArg+1 < argc)) {
+            checkPath = args[++iArg]; }
+        else {
+            printUsage(args[0]);
+            return EXIT_FAILURE; }
+    }
+
+    if (!setDimensions(optWR, optWC, optBR, optBC, vRows, vCols))
+    {
+        printUsage(args[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("World [%dx%d], Board [%dx%d], %d boards, %s layout\n\n", wRows, wCols, bRows, bCols, numBoards, layoutNames[tileLayout]);
+    printf("    seed      board   ");
+    for (int iS=0; iS<MAX_STAGE; iS++) {
+        printf(" %8s", stageNames[iS]); }
+    printf(" autotile entities   (ms)  hash\n");
+
+    vector<BoardResult> results;
+    GenTimes totTimes;
+    double   pathMs   = 0.0;
+    double   renderMs = 0.0;
+    uint64_t pathSum   = 0;
+    uint64_t renderSum = 0;
+    double   residentMB = 0.0;
+    double   denseMB    = 0.0;
+    int      numBlocks  = 0;
+    int      numBlocked = 0;
+    int      iSeed = 0;
+    while ((int)results.size() < numBoards)
+    {
+        // Once the list is exhausted, offset it so every world is new
+        setSeed(benchSeeds[iSeed%numBenchSeeds] + (iSeed/numBenchSeeds)*0x9E3779B9u);
+        iSeed++;
+
+        Gameboard* world = new Gameboard(-1,-1);
+        GenTimes   wTimes = world->getGenTimes();
+        printTimes("[world]  ", wTimes);
+        for (int iS=0; iS<MAX_STAGE; iS++) {
+            totTimes.stage[iS] += wTimes.stage[iS]; }
+        totTimes.autotile += wTimes.autotile;
+
+        // Tile storage after uniform chunks are folded
+        residentMB += world->getResidentBytes()/1048576.0;
+        denseMB    += world->getDenseBytes()/1048576.0;
+        for (int jj=0; jj<wRows; jj+=blkSize) {
+            for (int ii=0; ii<wCols; ii+=blkSize) {
+                numBlocks++;
+                numBlocked += world->getBlockBlocked(jj,ii); }
+        }
+
+        vector<Gameboard*> boards;
+        for (int jj=0; (jj<(wRows/bRows)) && ((int)results.size()<numBoards); jj++)
+        {
+            for (int ii=0; (ii<(wCols/bCols)) && ((int)results.size()<numBoards); ii++)
+            {
+                boards.push_back(new Gameboard(ii, jj, world));
+                GenTimes bTimes = boards.back()->getGenTimes();
+                totTimes.entities += bTimes.entities;
+
+                BoardResult res = { seed, ii, jj, boards.back()->getContentHash() };
+                results.push_back(res);
+                printf("%08x  [%3d,%3d]", seed, ii, jj);
+                for (int iS=0; iS<=MAX_STAGE; iS++) {
+                    printf(" %8s", ""); }
+                printf(" %8.3f         %016llx\n", bTimes.entities, (unsigned long long)res.hash);
+
+                if (optAccess)
+                {
+                    std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+                    pathSum  += runPaths(boards.back());
+                    pathMs   += elapsedMs(tStart);
+
+                    tStart    = std::chrono::steady_clock::now();
+                    renderSum = renderSum*31 + runRender(boards.back());
+                    renderMs += elapsedMs(tStart);
+                }
+            }
+        }
+
+        // Nudge a classify threshold, only classify and later stages rerun
+        if (optRegen)
+        {
+            TerrainParams tParams = terrainParams;
+            tParams.threshT03 += 0.01;
+            int numRun = world->regenerate(tParams);
+            printTimes("[regen]  ", world->getGenTimes());
+            if (numRun != MAX_STAGE-STAGE_CLASSIFY) {
+                printf("WARNING: Regeneration ran %d stages, expected %d\n", numRun, MAX_STAGE-STAGE_CLASSIFY); }
+        }
+
+        if (optHandles && (numBadHandles < 0) && !boards.empty()) {
+            numBadHandles = checkHandles(boards.front()); }
+
+        // Boards only view the world's tiles, so delete them before the world
+        for (vector<Gameboard*>::iterator iBrd=boards.begin(); iBrd!=boards.end(); iBrd++) {
+            delete (*iBrd); }
+        delete world;
+    }
+
+    printf("\n    total           ");
+    for (int iS=0; iS<MAX_STAGE; iS++) {
+        printf(" %8.3f", totTimes.stage[iS]); }
+    printf(" %8.3f %8.3f\n", totTimes.autotile, totTimes.entities);
+    printf("    tiles  %.2f MB resident of %.2f MB dense, %d of %d blocks all blocked\n",
+           residentMB, denseMB, numBlocked, numBlocks);
+    if (optAccess)
+    {
+        printf("    access (%s)  paths %10.3f ms  (length %llu)\n", layoutNames[tileLayout], pathMs, (unsigned long long)pathSum);
+        printf("    access (%s)  render %9.3f ms  (checksum %016llx)\n", layoutNames[tileLayout], renderMs, (unsigned long long)renderSum);
+    }
+    fflush(stdout);
+
+    if (!writePath.empty())
+    {
+        FILE* fOut = fopen(writePath.c_str(), "w");
+        if (nullptr == fOut) {
+            printf("ERROR: Unable to write golden file %s\n", writePath.c_str());
+            return EXIT_FAILURE;
+        }
+        for (vector<BoardResult>::iterator iRes=results.begin(); iRes!=results.end(); iRes++) {
+            fprintf(fOut, "%08x %d %d %016llx\n", iRes->seed, iRes->boardX, iRes->boardY, (unsigned long long)iRes->hash); }
+        fclose(fOut);
+        printf("INFO: Wrote %d board hashes to %s\n", (int)results.size(), writePath.c_str());
+    }
+
+    if (!checkPath.empty())
+    {
+        map<string,uint64_t> golden;
+        if (!readGolden(checkPath, golden)) {
+            return EXIT_FAILURE; }
+
+        int numBad = 0;
+        int numNew = 0;
+        char gKey[64];
+        for (vector<BoardResult>::iterator iRes=results.begin(); iRes!=results.end(); iRes++)
+        {
+            snprintf(gKey, sizeof(gKey), "%08x %d %d", iRes->seed, iRes->boardX, iRes->boardY);
+            map<string,uint64_t>::iterator iGold = golden.find(gKey);
+            if (iGold == golden.end()) {
+                numNew++; }
+            else if (iGold->second != iRes->hash) {
+                printf("MISMATCH: %s expected %016llx got %016llx\n", gKey,
+                       (unsigned long long)iGold->second, (unsigned long long)iRes->hash);
+                numBad++; }
+        }
+        printf("INFO: %d boards checked, %d mismatched, %d not in %s\n",
+               (int)results.size()-numNew, numBad, numNew, checkPath.c_str());
+        if (numBad > 0) {
+            return EXIT_FAILURE; }
+    }
+
+    if (numBadHandles > 0) {
+        return EXIT_FAILURE; }
+
+    return EXIT_SUCCESS;
+}
+
+// EOF
@@ -0,0 +1,235 @@
+/*
+ *  Chunk Cache Class
+ */
+
+#include "chunkcache.hh"
+#include "gameboard.hh"
+
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+ChunkCache::ChunkCache(const string& dir)
+{
+    cacheDir = dir;
+    enabled  = !cacheDir.empty();
+    hits     = 0;
+    misses   = 0;
+
+    if (enabled)
+    {
+        // Create the cache directory (ok if it already exists)
+#ifdef _WIN32
+        _mkdir(cacheDir.c_str());
+#else
+        mkdir(cacheDir.c_str(), 0755);
+#endif
+        struct stat st;
+        if ((0!=stat(cacheDir.c_str(), &st)) || !S_ISDIR(st.st_mode))
+        {
+            printf("WARNING: ChunkCache unable to use directory %s, caching disabled.\n", cacheDir.c_str()); fflush(stdout);
+            enabled = false;
+        }
+    }
+}
+
+ChunkCache::~ChunkCache()
+{
+    // Nothing to do for now...
+}
+
+string ChunkCache::chunkPath(Gameboard* brd)
+{
+    char fName[96];
+    snprintf(fName, sizeof(fName), "/s%08x_x%d_y%d_g%016llx.chunk",
+             seed, brd->getBoardX(), brd->getBoardY(),
+             (unsigned long long)brd->getGenHash());
+    return cacheDir+fName;
+}
+
+bool ChunkCache::parse(Gameboard* brd, const unsigned char* data, size_t len)
+{
+    // Validate everything before touching the board
+    if (len < sizeof(ChunkHeader)) {
+        return false; }
+
+    ChunkHeader hdr;
+    memcpy(&hdr, data, sizeof(hdr));
+
+    if ( (0!=memcmp(hdr.magic, "PVCK", 4)) ||
+         (hdr.format  != chunkFormat) ||
+         (hdr.seed    != seed) ||
+         (hdr.boardX  != brd->getBoardX()) ||
+         (hdr.boardY  != brd->getBoardY()) ||
+         (hdr.rows    != (uint32_t)brd->getRows()) ||
+         (hdr.cols    != (uint32_t)brd->getCols()) ||
+         (hdr.genHash != brd->getGenHash()) ) {
+        return false; }
+
+    size_t numTiles = (size_t)hdr.rows*hdr.cols;
+    if (len != sizeof(ChunkHeader) + 2*numTiles + (size_t)hdr.numNPCs*sizeof(ChunkNPC)) {
+        return false; }
+
+    // Elevations and biomes (sub-boards view the world's tiles, which are
+    // already loaded and autotiled, so only the world restores them)
+    const unsigned char* pElev  = data+sizeof(ChunkHeader);
+    const unsigned char* pBiome = pElev+numTiles;
+    if (brd->ownsTiles())
+    {
+        brd->beginEdit();
+        for (int jj=0; jj<brd->getRows(); jj++) {
+            for (int ii=0; ii<brd->getCols(); ii++) {
+                brd->getTile(jj,ii).setElev(pElev[jj*brd->getCols()+ii]);
+                brd->getTile(jj,ii).setTerrain(pBiome[jj*brd->getCols()+ii]);
+            }
+        }
+        brd->endEdit();
+    }
+
+    // Flora and fauna
+    const unsigned char* pNPC = pBiome+numTiles;
+    for (uint32_t iN=0; iN<hdr.numNPCs; iN++)
+    {
+        ChunkNPC rec;
+        memcpy(&rec, pNPC+iN*sizeof(ChunkNPC), sizeof(rec));
+        int slot = brd->addNPC(rec.x, rec.y, rec.type, (0!=rec.hostile), rec.moveProb);
+        brd->getNPCs()->lp[slot] = rec.lp;
+    }
+
+    return true;
+}
+
+bool ChunkCache::load(Gameboard* brd)
+{
+    if (!enabled) {
+        return false; }
+
+    string fPath = chunkPath(brd);
+    bool   found = false;
+
+#ifdef _WIN32
+    // No mmap, read the whole file instead
+    FILE* fIn = fopen(fPath.c_str(), "rb");
+    if (nullptr != fIn)
+    {
+        vector<unsigned char> fData;
+        fseek(fIn, 0, SEEK_END);
+        long fLen = ftell(fIn);
+        fseek(fIn, 0, SEEK_SET);
+        if (fLen > 0)
+        {
+            fData.resize(fLen);
+            if (fread(&fData[0], 1, fLen, fIn) == (size_t)fLen) {
+                found = parse(brd, &fData[0], fData.size()); }
+        }
+        fclose(fIn);
+    }
+#else
+    int fd = open(fPath.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        struct stat st;
+        if ((0==fstat(fd, &st)) && (st.st_size >= (off_t)sizeof(ChunkHeader)))
+        {
+            void* fData = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (MAP_FAILED != fData)
+            {
+                found = parse(brd, (const unsigned char*)fData, st.st_size);
+                munmap(fData, st.st_size);
+            }
+        }
+        close(fd);
+    }
+#endif
+
+    if (found) {
+        hits++; }
+    else {
+        misses++; }
+
+    return found;
+}
+
+bool ChunkCache::save(Gameboard* brd)
+{
+    if (!enabled) {
+        return false; }
+
+    NPCStore* npcs = brd->getNPCs();
+
+    ChunkHeader hdr;
+    memcpy(hdr.magic, "PVCK", 4);
+    hdr.format  = chunkFormat;
+    hdr.seed    = seed;
+    hdr.boardX  = brd->getBoardX();
+    hdr.boardY  = brd->getBoardY();
+    hdr.rows    = brd->getRows();
+    hdr.cols    = brd->getCols();
+    hdr.numNPCs = npcs->size()-npcs->dead.size();
+    hdr.genHash = brd->getGenHash();
+
+    size_t numTiles = (size_t)hdr.rows*hdr.cols;
+    vector<unsigned char> fData(sizeof(ChunkHeader) + 2*numTiles + hdr.numNPCs*sizeof(ChunkNPC));
+    memcpy(&fData[0], &hdr, sizeof(hdr));
+
+    unsigned char* pElev  = &fData[sizeof(ChunkHeader)];
+    unsigned char* pBiome = pElev+numTiles;
+    for (int jj=0; jj<brd->getRows(); jj++) {
+        for (int ii=0; ii<brd->getCols(); ii++) {
+            pElev[jj*brd->getCols()+ii]  = (unsigned char)brd->getTile(jj,ii).getElev();
+            pBiome[jj*brd->getCols()+ii] = brd->getTile(jj,ii).getTerrain();
+        }
+    }
+
+    unsigned char* pNPC = pBiome+numTiles;
+    for (int iN=0; iN<npcs->size(); iN++)
+    {
+        if (npcs->lp[iN] <= 0) {    // killed, not yet reaped
+            continue; }
+
+        ChunkNPC rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.x        = npcs->pos[iN].x;
+        rec.y        = npcs->pos[iN].y;
+        rec.lp       = npcs->lp[iN];
+        rec.moveProb = npcs->moveProb[iN];
+        rec.type     = npcs->type[iN];
+        rec.hostile  = npcs->hostile[iN];
+        memcpy(pNPC, &rec, sizeof(rec));
+        pNPC += sizeof(rec);
+    }
+
+    // Write to a temporary file and rename so a partial write is never loaded
+    string fPath = chunkPath(brd);
+    string tPath = fPath+".tmp";
+    FILE* fOut = fopen(tPath.c_str(), "wb");
+    if (nullptr == fOut)
+    {
+        printf("WARNING: ChunkCache unable to write %s\n", tPath.c_str()); fflush(stdout);
+        return false;
+    }
+    bool written = (fwrite(&fData[0], 1, fData.size(), fOut) == fData.size());
+    written = (0==fclose(fOut)) && written;
+
+#ifdef _WIN32
+    remove(fPath.c_str());
+#endif
+    if (!written || (0!=rename(tPath.c_str(), fPath.c_str())))
+    {
+        printf("WARNING: ChunkCache unable to write %s\n", fPath.c_str()); fflush(stdout);
+        remove(tPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// EOF
@@ -0,0 +1,81 @@
+/*
+ *  Chunk Cache Class
+ *
+ *  Generated boards are saved as compact binary files keyed by
+ *  (seed, board location, generator hash) and memory-mapped on load, so
+ *  revisiting a world or restarting on the same seed skips generation.
+ *
+ *  FILE LAYOUT (native endianness and packing):
+ *
+ *    ChunkHeader
+ *    uint8_t   elev[rows*cols]     (row-major)
+ *    uint8_t   biome[rows*cols]    (row-major, Tile terrain type)
+ *    ChunkNPC  npcs[numNPCs]
+ *
+ */
+
+#ifndef __CHUNKCACHE_HH__
+#define __CHUNKCACHE_HH__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class Gameboard;
+
+// Bump when the file layout changes (generation changes go in genVersion)
+static const uint32_t chunkFormat = 2;
+
+struct ChunkHeader {
+    char     magic[4];      // "PVCK"
+    uint32_t format;        // chunkFormat
+    uint32_t seed;          // game seed
+    int32_t  boardX;        // board location in world (-1,-1 is the world)
+    int32_t  boardY;
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t numNPCs;
+    uint64_t genHash;       // Gameboard::getGenHash()
+};
+
+struct ChunkNPC {
+    int32_t  x;
+    int32_t  y;
+    int32_t  lp;
+    float    moveProb;
+    uint8_t  type;
+    uint8_t  hostile;
+    uint8_t  pad[2];
+};
+
+class ChunkCache
+{
+private:
+    string cacheDir;
+    bool   enabled;
+    int    hits;
+    int    misses;
+
+    string chunkPath(Gameboard*);
+    bool   parse(Gameboard*, const unsigned char*, size_t);
+
+public:
+    // Constructor & Destructor (an empty directory disables the cache)
+    ChunkCache(const string& dir);
+    ~ChunkCache();
+
+    // Restore a board from the cache. Returns false (board untouched) on a miss.
+    bool load(Gameboard*);
+
+    // Write a freshly generated board to the cache
+    bool save(Gameboard*);
+
+    bool getEnabled() { return enabled; };
+    int  getHits()    { return hits; };
+    int  getMisses()  { return misses; };
+};
+
+#endif
+// EOF
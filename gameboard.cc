@@ -3,110 +3,274 @@
  */
 
 #include "gameboard.hh"
+#include "chunkcache.hh"
+#include "spawn.hh"
 
-Gameboard::Gameboard(int locX, int locY, Gameboard* inWorld)
+// Default dimensions (see setDimensions)
+int wRows   = 64;
+int wCols   = 64;
+int wRadius = sqrt(((wRows/2)^2)+((wCols/2)^2));
+
+int bRows   = 64;
+int bCols   = 64;
+int bRadius = sqrt(((bRows/2)^2)+((bCols/2)^2));
+
+int vRows   = 64;
+int vCols   = 64;
+int vRadius = sqrt(((vRows/2)^2)+((vCols/2)^2));
+
+TILE_LAYOUT tileLayout = LAYOUT_ROWS;
+
+bool setDimensions(int wR, int wC, int bR, int bC, int vR, int vC)
+{
+    if ( (wR<1) || (wC<1) || (bR<1) || (bC<1) || (vR<1) || (vC<1) ||
+         (wR>maxDim) || (wC>maxDim) || (bR>maxDim) || (bC>maxDim) ||
+         (vR>maxDim) || (vC>maxDim) )
+    {
+        printf("ERROR: Dimensions must be between 1 and %d.\n", maxDim); fflush(stdout);
+        return false;
+    }
+
+    if ( (bR>wR) || (bC>wC) )
+    {
+        printf("ERROR: Board [%dx%d] does not fit in world [%dx%d].\n", bR, bC, wR, wC); fflush(stdout);
+        return false;
+    }
+
+    wRows = wR;
+    wCols = wC;
+    bRows = bR;
+    bCols = bC;
+    vRows = vR;
+    vCols = vC;
+
+    // NOTE: '^' is XOR here, not a power. The valley falloff in stageFalloff
+    //       is tuned around these values, so keep the original expression.
+    wRadius = sqrt(((wRows/2)^2)+((wCols/2)^2));
+    bRadius = sqrt(((bRows/2)^2)+((bCols/2)^2));
+    vRadius = sqrt(((vRows/2)^2)+((vCols/2)^2));
+
+    return true;
+}
+
+// Milliseconds since tStage, then restart tStage (for stage timings)
+static double stageMs(std::chrono::steady_clock::time_point& tStage)
+{
+    std::chrono::steady_clock::time_point tNow = std::chrono::steady_clock::now();
+    double dMs = std::chrono::duration<double, std::milli>(tNow-tStage).count();
+    tStage = tNow;
+    return dMs;
+}
+
+Gameboard::Gameboard(int locX, int locY, Gameboard* inWorld, ChunkCache* cache)
+    : npcs(this)
 {
     //printf("DEBUG: Gameboard::Gameboard Creating new board at [%2d,%2d].\n", locX, locY);
 
     bPos.x = locX;
     bPos.y = locY;
 
+    tParams = terrainParams;
+
     if (nullptr != inWorld)
     {
-        // Initialize all board tiles based on section of world
-        for (int jj=0; jj<bRows; jj++)
+        mRows   = bRows;
+        mCols   = bCols;
+        mRadius = bRadius;
+
+        // View the board's section of the world tiles (owned by the world)
+        wOrig = bLoc{mCols*locX, mRows*locY};
+        view  = inWorld->getView(wOrig.y, wOrig.x);
+
+        if ((nullptr==cache) || !cache->load(this))
         {
-            for (int ii=0; ii<bCols; ii++)
-            {
-                board[jj][ii] = inWorld->getTile((bRows*locY)+jj,
-                                                 (bCols*locX)+ii);
-            }
-        }
+            placeEntities(inWorld);
 
-        placeEntities();
+            if (nullptr!=cache) {
+                cache->save(this); }
+        }
     }
     else
     {
+        mRows   = wRows;
+        mCols   = wCols;
+        mRadius = wRadius;
+        wOrig   = bLoc{0, 0};
+
         // Initialize world tiles and create map
-        for (int jj=0; jj<wRows; jj++)
+        tiles.resize(mRows, mCols, 2, tileLayout);
+        view.store  = &tiles;
+        view.row0   = 0;
+        view.col0   = 0;
+
+        if ((nullptr==cache) || !cache->load(this))
         {
-            for (int ii=0; ii<wCols; ii++)
-            {
-                board[jj][ii] = new Tile(ii, jj, 2);
-            }
+            runPipeline();
+
+            if (nullptr!=cache) {
+                cache->save(this); }
+        }
+        else
+        {
+            // Cached worlds skip the terrain stages, but boards still need densities
+            std::chrono::steady_clock::time_point tStage = std::chrono::steady_clock::now();
+            stageDensity();
+            genTimes.stage[STAGE_DENSITY] = stageMs(tStage);
         }
 
-        createMap();
+        // Corners are derived from elevations, so they are never cached
+        autotile();
     }
 }
 
 Gameboard::~Gameboard()
 {
-    // Delete Tiles
     //printf("DEBUG: Begin Gameboard destructor.\n");
 
-    for (int jj=0; jj<bRows; jj++)
+    for (vector<River*>::iterator iRvr=mRivers.begin(); iRvr!=mRivers.end(); iRvr++)
+    {
+        delete (*iRvr);
+    }
+
+    //printf("DEBUG: End Gameboard destructor.\n");
+}
+
+int Gameboard::runPipeline()
+{
+    typedef void (Gameboard::*StageFn)();
+    static const StageFn stageFns[MAX_STAGE] = {
+        &Gameboard::stageNoise,    &Gameboard::stageFalloff, &Gameboard::stageErosion,
+        &Gameboard::stageClassify, &Gameboard::stageRivers,  &Gameboard::stageDensity };
+
+    int      numRun = 0;
+    uint64_t key    = 14695981039346656037ULL;
+    for (int iS=0; iS<MAX_STAGE; iS++)
     {
-        for (int ii=0; ii<bCols; ii++)
+        key = stageHash((GEN_STAGE)iS, key);
+        genTimes.stage[iS] = 0.0;
+
+        // Once a stage reruns, every later stage has stale inputs
+        if ((numRun > 0) || (key != layers.stageKey[iS]))
         {
-            delete board[jj][ii];
-            board[jj][ii] = nullptr;
+            std::chrono::steady_clock::time_point tStage = std::chrono::steady_clock::now();
+            (this->*stageFns[iS])();
+            genTimes.stage[iS]  = stageMs(tStage);
+            layers.stageKey[iS] = key;
+            numRun++;
         }
     }
 
-    while (!bNPCs.empty())
+    return numRun;
+}
+
+int Gameboard::regenerate(const TerrainParams& inParams)
+{
+    tParams = inParams;
+
+    int numRun = runPipeline();
+
+    // Tiles only change when the rivers stage (which writes them) reran
+    if ((MAX_STAGE-numRun) <= STAGE_RIVERS) {
+        autotile(); }
+
+    return numRun;
+}
+
+void Gameboard::stageNoise()
+{
+    // Elevation and climate fields from one fused noise pass, by chunk
+    TerrainSampler sampler(tParams, wRows, wCols, wRadius);
+    layers.noiseElev.resize(mRows*mCols);
+    layers.climate.resize(mRows*mCols);
+
+    forEachChunk(mRows, mCols, bRows, bCols, [&](const TerrainChunk& chunk) {
+        double chOut[MAX_CHANNEL];
+        for (int jj=chunk.row0; jj<chunk.row1; jj++)
+        {
+            for (int ii=chunk.col0; ii<chunk.col1; ii++)
+            {
+                sampler.noiseChannels(wOrig.y+jj,wOrig.x+ii,chOut);
+                layers.noiseElev[jj*mCols+ii] = chOut[CH_ELEV];
+                layers.climate[jj*mCols+ii]   = sampler.climateClass(chOut[CH_TEMP],chOut[CH_MOIST]);
+            }
+        }
+    });
+}
+
+void Gameboard::stageFalloff()
+{
+    // Shape the elevation field into the (world centered) valley, by chunk
+    TerrainSampler sampler(tParams, wRows, wCols, wRadius);
+    layers.shapedElev.resize(mRows*mCols);
+
+    forEachChunk(mRows, mCols, bRows, bCols, [&](const TerrainChunk& chunk) {
+        for (int jj=chunk.row0; jj<chunk.row1; jj++)
+        {
+            for (int ii=chunk.col0; ii<chunk.col1; ii++)
+            {
+                layers.shapedElev[jj*mCols+ii] = sampler.falloff(wOrig.y+jj,wOrig.x+ii,layers.noiseElev[jj*mCols+ii]);
+            }
+        }
+    });
+}
+
+void Gameboard::stageErosion()
+{
+    // Erosion moves material between neighbors, so it runs over the whole map
+    layers.elevF = layers.shapedElev;
+
+    if (tParams.erosion.enabled)
     {
-        bNPCs.pop_back();
+        erodeTerrain(layers.elevF, mRows, mCols, tParams.erosion);
     }
+}
 
-    //printf("DEBUG: End Gameboard destructor.\n");
+void Gameboard::stageClassify()
+{
+    // Classify elevations and biomes
+    TerrainSampler sampler(tParams, wRows, wCols, wRadius);
+    layers.elevClass.resize(mRows*mCols);
+    layers.biome.resize(mRows*mCols);
+
+    for (int iT=0; iT<mRows*mCols; iT++)
+    {
+        int eClass = sampler.elevClass(layers.elevF[iT]);
+        layers.elevClass[iT] = eClass;
+        layers.biome[iT]     = sampler.biome(eClass,layers.climate[iT]);
+    }
 }
 
-bool Gameboard::createMap()
+void Gameboard::stageRivers()
 {
-    // FastNoiseLite Implementation
-    FastNoiseLite noise;
-    noise.SetSeed(seed);
-    noise.SetFrequency(0.06f);
-    noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
-    noise.SetRotationType3D(FastNoiseLite::RotationType3D_ImproveXYPlanes);
-    noise.SetFractalOctaves(4);
-
-    double dvsr = 2.29928*log(0.0337477*bRows);  // log fit {120,3.3},{240,4.8},{320,5.2},{480,6.6}
-    //printf("DEBUG: Elevation Adjustment Divisor = %4.2g\n",dvsr); fflush(stdout);
-
-    // Create the tile map using noise
-    for (int jj=0; jj<bRows; jj++)
+    // Rivers path across the whole map, so (like erosion) they are not chunked
+    TerrainSampler sampler(tParams, wRows, wCols, wRadius);
+
+    // Rivers path through the classified tile map (occupancy must be current for findPath)
+    beginEdit();
+    for (int jj=0; jj<mRows; jj++)
     {
-        for (int ii=0; ii<bCols; ii++)
+        for (int ii=0; ii<mCols; ii++)
         {
-            double dElev = ((noise.GetNoise((double)jj,(double)ii)+1.0)/2.0)*elevMax;
-            // printf("DEBUG: Elevation = %2.4g\n",dElev); fflush(stdout);
-
-            /*
-            ** Use a power function to increase elevation further away from
-            ** map center to create "valley". Clamp to max elevation.
-            */
-            double dist = sqrt( pow((jj-(bRows/2)),2) + pow((ii-(bCols/2)),2) );
-            dElev += pow(double(dist)/double(bRadius)/dvsr,15.0);
-            dElev = min((int)dElev, elevMax);
-
-            //if      ( dElev >= threshT08*elevMax ) { board[jj][ii]->setElev(8); }
-            //else if ( dElev >= threshT07*elevMax ) { board[jj][ii]->setElev(7); }
-            //else if ( dElev >= threshT06*elevMax ) { board[jj][ii]->setElev(6); }
-            //else if ( dElev >= threshT05*elevMax ) { board[jj][ii]->setElev(5); }
-            if      ( dElev >= threshT04*elevMax ) { board[jj][ii]->setElev(4); }
-            else if ( dElev >= threshT03*elevMax ) { board[jj][ii]->setElev(3); }
-            else if ( dElev >= threshT02*elevMax ) { board[jj][ii]->setElev(2); }
-            else if ( dElev >= threshT01*elevMax ) { board[jj][ii]->setElev(1); }
-            else                                   { board[jj][ii]->setElev(0); }
+            getTile(jj,ii).setElev(layers.elevClass[jj*mCols+ii]);
+            getTile(jj,ii).setTerrain(layers.biome[jj*mCols+ii]);
         }
     }
+    endEdit();
+    layers.riverMask.assign(mRows*mCols, 0);
 
     /*
     ** Generate River(s)
     */
 
+    // Rivers draw from their own stream, keyed by board location
+    bRng.seed(deriveSeed(SEED_RIVER, bPos.x, bPos.y));
+
+    // Forget rivers from an earlier run
+    for (vector<River*>::iterator iRvr=mRivers.begin(); iRvr!=mRivers.end(); iRvr++) {
+        delete (*iRvr); }
+    mRivers.clear();
+    riversAvail.clear();
+
     // Push all directions into available rivers list
     riversAvail.push_back(NORTH);
     riversAvail.push_back(EAST);
@@ -116,8 +280,8 @@ bool Gameboard::createMap()
     // Pick all river starting locations (directional borders)
     for (int rr=0; rr<numRivers; rr++)
     {
-        std::shuffle(std::begin(riversAvail), std::end(riversAvail), mt);
-        mRivers.push_back(new River(riversAvail.back()));
+        std::shuffle(std::begin(riversAvail), std::end(riversAvail), bRng);
+        mRivers.push_back(new River(riversAvail.back(), mRows, mCols, bRng));
 
         // Pop off back of available rivers if rivers 
         // from the same direction are undesired
@@ -125,190 +289,491 @@ bool Gameboard::createMap()
     }
 
     vector<bLoc> masterRvrQ;
-    masterRvrQ.push_back(bLoc{bCols/2,bRows/2});
+    masterRvrQ.push_back(bLoc{mCols/2,mRows/2});
     for (vector<River*>::iterator iRvr=mRivers.begin(); iRvr!=mRivers.end(); iRvr++)
     {
         //printf("DEBUG: Creating River from %2d\n",(*iRvr)->getBorder()); fflush(stdout);
         // findPath for rivers is weighted to help river flow through lowest elevation path
-        vector<bLoc> rvrQ = findPath(bLoc{bCols/2,bRows/2},(*iRvr)->getMouth(),this,rvrElevWeight);
+        vector<bLoc> rvrQ = findPath(bLoc{mCols/2,mRows/2},(*iRvr)->getMouth(),this,rvrElevWeight);
         masterRvrQ.insert(masterRvrQ.end(),rvrQ.begin(),rvrQ.end());
         masterRvrQ.push_back((*iRvr)->getMouth());
     }
     double rvrW; // Vary river width
+    beginEdit();
     while (!masterRvrQ.empty()) {
-        rvrW = randI(0,riverWidth)+riverWidth;
+        rvrW = randI(bRng,0,riverWidth)+riverWidth;
         for (int dy=ceil(-rvrW/2.0); dy<ceil(rvrW/2.0); dy++)
         {
             for (int dx=ceil(-rvrW/2.0); dx<ceil(rvrW/2.0); dx++)
             {
-                if(board[std::max(0, std::min(masterRvrQ.back().y+dy, bRows-1))]
-                     [std::max(0, std::min(masterRvrQ.back().x+dx, bCols-1))]->getElev() < 4)       // TODO: get rid of magic number (max elev)
+                int rvrRow = std::max(0, std::min(masterRvrQ.back().y+dy, mRows-1));
+                int rvrCol = std::max(0, std::min(masterRvrQ.back().x+dx, mCols-1));
+                Tile rvrTile = getTile(rvrRow, rvrCol);
+                if (rvrTile.getElev() < 4)       // TODO: get rid of magic number (max elev)
                 {
-                    int newElev = board[std::max(0, std::min(masterRvrQ.back().y+dy, bRows-1))]
-                                       [std::max(0, std::min(masterRvrQ.back().x+dx, bCols-1))]->getElev();
-                    newElev = max(newElev-randI(0,1),0);
+                    int newElev = rvrTile.getElev();
+                    newElev = max(newElev-randI(bRng,0,1),0);
 
-                    board[std::max(0, std::min(masterRvrQ.back().y+dy, bRows-1))]
-                         [std::max(0, std::min(masterRvrQ.back().x+dx, bCols-1))]->setElev(randI(0,1));
-                         //[std::max(0, std::min(masterRvrQ.back().x+dx, bCols-1))]->setElev(1);
+                    rvrTile.setElev(randI(bRng,0,1));
+                    //rvrTile.setElev(1);
+                    rvrTile.setTerrain(sampler.biome(rvrTile.getElev(),layers.climate[rvrRow*mCols+rvrCol]));
+                    layers.riverMask[rvrRow*mCols+rvrCol] = rvrTile.getElev()+1;
                 }
             }
         }
         masterRvrQ.pop_back();
     }
+    endEdit();
+}
 
-    return true;
+void Gameboard::stageDensity()
+{
+    // Spawn density of every rule on every tile, from the final elevations
+    int numTiles = mRows*mCols;
+    layers.density.resize(spawnTable.size()*numTiles);
+
+    for (size_t iR=0; iR<spawnTable.size(); iR++)
+    {
+        double* rDens = &layers.density[iR*numTiles];
+        for (int iT=0; iT<numTiles; iT++)
+        {
+            int tElev = getTile(iT/mCols, iT%mCols).getElev();
+            rDens[iT] = ((tElev>=0) && (tElev<numElevs)) ? spawnTable[iR].density[tElev]/1000.0 : 0.0;
+        }
+    }
 }
 
-void Gameboard::placeEntities()
+void Gameboard::autotile()
 {
-    // Run through all board tiles for final touches
-    for (int jj=0; jj<bRows; jj++)
+    std::chrono::steady_clock::time_point tStage = std::chrono::steady_clock::now();
+
+    // Packed elevation grid with a one tile border (edges replicated)
+    int pCols = mCols+2;
+    vector<unsigned char> pElev((mRows+2)*pCols);
+    for (int jj=-1; jj<=mRows; jj++)
     {
-        for (int ii=0; ii<bCols; ii++)
+        for (int ii=-1; ii<=mCols; ii++)
         {
-/*
-            // Check/Set terrain tile corners
-            //printf("DEBUG: Checking Corners...\n"); fflush(stdout);
-            if ((jj>0) && (jj<(bRows-1)) && (ii>0) && (ii<(bCols-1)))
-            {
+            pElev[(jj+1)*pCols+(ii+1)] = getTile(std::max(0, std::min(jj, mRows-1)),
+                                                 std::max(0, std::min(ii, mCols-1))).getElev();
+        }
+    }
 
-                //// Check/Set NE Corner
-                //if ( (board[jj-1][ii+1]->getElev() == board[jj][ii+1]->getElev() ) &&
-                //     (board[jj-1][ii+1]->getElev() == board[jj-1][ii]->getElev() ) )
-                //{
-                //    board[jj][ii]->setCrnr(NE_IC,board[jj-1][ii+1]->getElev());
-                //}
-
-                //// Check/Set SE Corner
-                //if ( (board[jj+1][ii+1]->getElev() == board[jj][ii+1]->getElev() ) &&
-                //     (board[jj+1][ii+1]->getElev() == board[jj+1][ii]->getElev() ) )
-                //{
-                //    board[jj][ii]->setCrnr(SE_IC,board[jj+1][ii+1]->getElev());
-                //}
-
-                //// Check/Set SW Corner
-                //if ( (board[jj+1][ii-1]->getElev() == board[jj][ii-1]->getElev() ) &&
-                //     (board[jj+1][ii-1]->getElev() == board[jj+1][ii]->getElev() ) )
-                //{
-                //    board[jj][ii]->setCrnr(SW_IC,board[jj+1][ii-1]->getElev());
-                //}
-
-                //// Check/Set NW Corner
-                //if ( (board[jj-1][ii-1]->getElev() == board[jj][ii-1]->getElev() ) &&
-                //     (board[jj-1][ii-1]->getElev() == board[jj-1][ii]->getElev() ) )
-                //{
-                //    board[jj][ii]->setCrnr(NW_IC,board[jj-1][ii-1]->getElev());
-                //}
-// above logic only updates corners when surrounded on 3 sides by same elev
-// below logic updates corners if 2 adjacent same elevs but NOT caddy corner
-                // Check/Set NE Corner
-                if ( (board[jj-1][ii+1]->getElev() != board[jj][ii]->getElev() ) &&
-                     (board[jj][ii+1]->getElev()   == board[jj-1][ii]->getElev() ) )
-                {
-                    board[jj][ii]->setCrnr(NE_IC,board[jj][ii+1]->getElev());
-                }
+    vector<unsigned char> rMask(mCols);
+    vector<unsigned char> rCrnr(mCols);
 
-                // Check/Set SE Corner
-                if ( (board[jj+1][ii+1]->getElev() != board[jj][ii]->getElev() ) &&
-                     (board[jj][ii+1]->getElev()   == board[jj+1][ii]->getElev() ) )
-                {
-                    board[jj][ii]->setCrnr(SE_IC,board[jj][ii+1]->getElev());
-                }
+    for (int jj=0; jj<mRows; jj++)
+    {
+        // Rows above, at and below jj (index -1 and mCols are the border)
+        const unsigned char* rN = &pElev[(jj  )*pCols+1];
+        const unsigned char* rC = &pElev[(jj+1)*pCols+1];
+        const unsigned char* rS = &pElev[(jj+2)*pCols+1];
+        unsigned char* mOut = &rMask[0];
+        unsigned char* cOut = &rCrnr[0];
+
+        // Branch-free sweep over the row so the compiler can vectorise it
+        for (int ii=0; ii<mCols; ii++)
+        {
+            unsigned char cc = rC[ii];
+            mOut[ii] = (unsigned char)( ((rN[ii  ] != cc) ? NBR_N  : 0) |
+                                        ((rN[ii+1] != cc) ? NBR_NE : 0) |
+                                        ((rC[ii+1] != cc) ? NBR_E  : 0) |
+                                        ((rS[ii+1] != cc) ? NBR_SE : 0) |
+                                        ((rS[ii  ] != cc) ? NBR_S  : 0) |
+                                        ((rS[ii-1] != cc) ? NBR_SW : 0) |
+                                        ((rC[ii-1] != cc) ? NBR_W  : 0) |
+                                        ((rN[ii-1] != cc) ? NBR_NW : 0) );
+
+            // A corner takes the elevation of its two edge neighbors when
+            // they match each other but differ from this tile (and so does
+            // the diagonal). Its bit is set, the elevation is read from the
+            // east/west neighbor (see Tile::getCrnr).
+            unsigned char eE = rC[ii+1];
+            unsigned char eW = rC[ii-1];
+            cOut[ii] = (unsigned char)( (((eE != cc) && (rN[ii+1] != cc) && (eE == rN[ii])) ? (1<<NE_IC) : 0) |
+                                        (((eE != cc) && (rS[ii+1] != cc) && (eE == rS[ii])) ? (1<<SE_IC) : 0) |
+                                        (((eW != cc) && (rS[ii-1] != cc) && (eW == rS[ii])) ? (1<<SW_IC) : 0) |
+                                        (((eW != cc) && (rN[ii-1] != cc) && (eW == rN[ii])) ? (1<<NW_IC) : 0) );
+        }
 
-                // Check/Set SW Corner
-                if ( (board[jj+1][ii-1]->getElev() != board[jj][ii]->getElev() ) &&
-                     (board[jj][ii-1]->getElev()   == board[jj+1][ii]->getElev() ) )
-                {
-                    board[jj][ii]->setCrnr(SW_IC,board[jj][ii-1]->getElev());
-                }
+        // Store alongside the tiles
+        for (int ii=0; ii<mCols; ii++)
+        {
+            Tile tTile = getTile(jj,ii);
+            tTile.setNbrMask(rMask[ii]);
+            tTile.setCrnrMask(rCrnr[ii]);
+        }
+    }
 
-                // Check/Set NW Corner
-                if ( (board[jj-1][ii-1]->getElev() != board[jj][ii]->getElev() ) &&
-                     (board[jj][ii-1]->getElev()   == board[jj-1][ii]->getElev() ) )
-                {
-                    board[jj][ii]->setCrnr(NW_IC,board[jj][ii-1]->getElev());
-                }
+    // The tiles are final: fold uniform chunks back into shared ones
+    tiles.compact();
+    genTimes.autotile = stageMs(tStage);
+}
+
+void Gameboard::placeEntities(Gameboard* inWorld)
+{
+    std::chrono::steady_clock::time_point tStage = std::chrono::steady_clock::now();
+
+    // Entities draw from their own stream, keyed by board location
+    bRng.seed(deriveSeed(SEED_ENTITY, bPos.x, bPos.y));
+
+    // Add some NPCs from the spawn table
+    // TODO: Consider moving NPC population into a separate handler class (i.e. pupeteer?)
+    //printf("DEBUG: Adding NPCs...\n"); fflush(stdout);
+    int numTiles = mRows*mCols;
+
+    // Spatial hash of spawned locations for the minimum distance checks.
+    // Cells are at least as large as any spawn radius, so only the 3x3
+    // neighborhood of cells around a candidate needs to be checked.
+    double maxDist = 1.0;
+    for (vector<SpawnRule>::iterator iRule=spawnTable.begin(); iRule!=spawnTable.end(); iRule++) {
+        maxDist = std::max(maxDist, iRule->minDist);
+    }
+    int cellSize = (int)ceil(maxDist);
+    int gRows    = (mRows+cellSize-1)/cellSize;
+    int gCols    = (mCols+cellSize-1)/cellSize;
+    vector<int>  cellHead(gRows*gCols, -1);     // first spawn in each cell
+    vector<int>  cellNext;                      // next spawn in the same cell
+    vector<bLoc> spawnLocs;
+
+    vector<double> cumDens(numTiles);
+
+    for (vector<SpawnRule>::iterator iRule=spawnTable.begin(); iRule!=spawnTable.end(); iRule++)
+    {
+        // Cumulative spawn density over the board (no random draws)
+        int    iR      = iRule-spawnTable.begin();
+        double totDens = 0.0;
+        for (int jj=0; jj<mRows; jj++)
+        {
+            for (int ii=0; ii<mCols; ii++)
+            {
+                totDens += inWorld->getDensity(iR, (mRows*bPos.y)+jj, (mCols*bPos.x)+ii);
+                cumDens[jj*mCols+ii] = totDens;
             }
-*/
-
-            // Add some NPCs
-            // TODO: Consider moving NPC population into a separate handler class (i.e. pupeteer?)
-            // TODO: Remove magic numbers for elevation checks
-            //printf("DEBUG: Adding NPCs...\n"); fflush(stdout);
-
-            //if (board[jj][ii]->getElev() == 4) {
-            //    // Place a mountain here
-            //    bNPCs.push_back(new NPC(this, ii, jj, 'm', false, 0.0));
-            //    //bNPCs.back()->setVulnerable(false);   // Make mountains invincible
-            //    bNPCs.back()->setLP(1);
-            //    board[jj][ii]->setPawn(bNPCs.back());
-            //}; else
-            if ( (board[jj][ii]->getElev() == 2) || (board[jj][ii]->getElev() == 3) )
+        }
+        if (totDens <= 0.0) {
+            continue; }
+
+        // Draw the number of spawns, then dart-throw each one
+        int    numSpawn = randPoisson(bRng, totDens);
+        double minDist2 = iRule->minDist*iRule->minDist;
+
+        for (int iS=0; iS<numSpawn; iS++)
+        {
+            for (int iTry=0; iTry<spawnTries; iTry++)
             {
-                if (randI1000()<20)
+                // Pick a tile with probability proportional to its density
+                int iT = std::upper_bound(cumDens.begin(), cumDens.end(), randUnit(bRng)*totDens) - cumDens.begin();
+                iT = std::min(iT, numTiles-1);
+                bLoc tLoc = bLoc{iT%mCols, iT/mCols};
+
+                if (getBlocked(tLoc.y, tLoc.x) || getTile(tLoc.y, tLoc.x).hasOccupant()) {
+                    continue; }
+
+                // Reject if too close to an existing spawn
+                bool tooClose = false;
+                int  gX = tLoc.x/cellSize;
+                int  gY = tLoc.y/cellSize;
+                for (int gy=std::max(0,gY-1); (gy<=std::min(gRows-1,gY+1)) && !tooClose; gy++)
                 {
-                    // Place a cactus here
-                    bNPCs.push_back(new NPC(this, ii, jj, 'c', false, 0.0));
-                    board[jj][ii]->setPawn(bNPCs.back());
-                }
-                else if (randI1000()<20)
-                {
-                    int randTmp = randI1000();
-                    if (randTmp<900)
-                    {
-                        // Place a cow here
-                        bNPCs.push_back(new NPC(this, ii, jj, 'w', false, 0.9));
-                        board[jj][ii]->setPawn(bNPCs.back());
-                    }
-                    else
+                    for (int gx=std::max(0,gX-1); (gx<=std::min(gCols-1,gX+1)) && !tooClose; gx++)
                     {
-                        // Place a gila monster here
-                        bNPCs.push_back(new NPC(this, ii, jj, 'g', true, 0.7));
-                        board[jj][ii]->setPawn(bNPCs.back());
+                        for (int iN=cellHead[gy*gCols+gx]; iN>=0; iN=cellNext[iN])
+                        {
+                            bLoc dLoc = spawnLocs[iN]-tLoc;
+                            if ((dLoc.x*dLoc.x + dLoc.y*dLoc.y) < minDist2) {
+                                tooClose = true;
+                                break; }
+                        }
                     }
                 }
+                if (tooClose) {
+                    continue; }
+
+                addNPC(tLoc.x, tLoc.y, iRule->npcType, iRule->hostile, iRule->moveProb);
+
+                spawnLocs.push_back(tLoc);
+                cellNext.push_back(cellHead[gY*gCols+gX]);
+                cellHead[gY*gCols+gX] = spawnLocs.size()-1;
+                break;
             }
         }
     }
+    genTimes.entities = stageMs(tStage);
 }
 
-Tile* Gameboard::getTile(int row, int col)
+BoardView Gameboard::getView(int row, int col)
 {
-    return board[row][col];
+    BoardView bView;
+    bView.store  = view.store;
+    bView.row0   = view.row0+row;
+    bView.col0   = view.col0+col;
+    return bView;
 }
 
-vector<NPC*>* Gameboard::getNPCs()
+BoardSnapshot::BoardSnapshot(const BoardView& inView, int rows, int cols)
 {
-    return &bNPCs;
+    store      = make_shared<TileStore>(inView.store->snapshot(inView.row0, inView.col0, rows, cols));
+    view       = inView;
+    view.store = store.get();
+    mRows      = rows;
+    mCols      = cols;
 }
 
-void Gameboard::checkNPCs(bLoc playerPos)
+// Clip bits of columns [col, col+64) to the board's right edge
+static uint64_t clipBits(Gameboard* brd, uint64_t bits, int col)
+{
+    int num = brd->getCols()-col;
+    if (num < 64) {
+        bits &= (1ULL<<num)-1; }
+    return bits;
+}
+
+// Free bits of columns [col, col+64) of a row, clipped to the board
+static uint64_t freeBits(Gameboard* brd, int row, int col)
+{
+    return clipBits(brd, ~brd->getBlockedBits(row, col), col);
+}
+
+int Gameboard::countFree()
 {
-    // Check/Update the status of all NPCs on the board
-    for (vector<NPC*>::iterator iNPC=bNPCs.begin(); iNPC!=bNPCs.end();)
+    int numFree = 0;
+    for (int jj=0; jj<mRows; jj++)
     {
-        // Remove NPCs with with no life
-        if ((*iNPC)->getLP() <= 0)
+        for (int ii=0; ii<mCols; ii+=64) {
+            numFree += popCount(freeBits(this, jj, ii)); }
+    }
+    return numFree;
+}
+
+bLoc Gameboard::getFree(int kk)
+{
+    for (int jj=0; jj<mRows; jj++)
+    {
+        for (int ii=0; ii<mCols; ii+=64)
+        {
+            uint64_t bits = freeBits(this, jj, ii);
+            int      num  = popCount(bits);
+            if (kk < num) {
+                return bLoc{ii+selectBit(bits, kk), jj}; }
+            kk -= num;
+        }
+    }
+    return bLoc{-1, -1};
+}
+
+void Gameboard::setDirty(int row, int col, int rows, int cols, bool isDirty)
+{
+    for (int jj=row; jj<row+rows; jj++) {
+        view.store->setDirty(view.row0+jj, view.col0+col, cols, isDirty); }
+}
+
+void Gameboard::getDirtyRects(vector<DirtyRect>& rects)
+{
+    rects.clear();
+
+    // Rects that reach the previous row, in column order. A run of dirty
+    // tiles spanning the same columns as one of them extends it downward.
+    vector<int> openRects;
+    vector<int> nextOpen;
+    size_t      iOpen = 0;
+
+    auto addRun = [&](int row, int col, int cols)
+    {
+        while ((iOpen < openRects.size()) && (rects[openRects[iOpen]].col < col)) {
+            iOpen++; }
+
+        if ((iOpen < openRects.size()) && (rects[openRects[iOpen]].col == col) &&
+            (rects[openRects[iOpen]].cols == cols))
         {
-            //printf("DEBUG: Gameboard::checkNPCs removing pawn %1c from board\n",(*iNPC)->getType()); fflush(stdout);
-            getTile((*iNPC)->getY(),(*iNPC)->getX())->rmvPawn();
-            iNPC = bNPCs.erase(iNPC);
+            rects[openRects[iOpen]].rows++;
+            nextOpen.push_back(openRects[iOpen++]);
         }
         else
         {
-            // Check/update isActive status (only execute if the NPC actually moves)
-            // TODO: refine criteria for activate/inactivate NPCs (dist from player?)
-            if ( (*iNPC)->getMoveProb() > 1e-6 )
+            nextOpen.push_back(rects.size());
+            rects.push_back(DirtyRect{row, col, 1, cols});
+        }
+    };
+
+    for (int jj=0; jj<mRows; jj++)
+    {
+        int runCol = -1;
+        int runEnd = -1;
+        for (int ii=0; ii<mCols; ii+=64)
+        {
+            for (int iB : SetBits(clipBits(this, view.dirtyBits(jj, ii), ii)))
+            {
+                if (ii+iB == runEnd) {
+                    runEnd++;
+                    continue; }
+
+                if (runCol >= 0) {
+                    addRun(jj, runCol, runEnd-runCol); }
+                runCol = ii+iB;
+                runEnd = runCol+1;
+            }
+        }
+        if (runCol >= 0) {
+            addRun(jj, runCol, runEnd-runCol); }
+
+        openRects.swap(nextOpen);
+        nextOpen.clear();
+        iOpen = 0;
+    }
+}
+
+// FNV-1a hash accumulation
+static uint64_t fnvBytes(uint64_t hh, const void* pData, size_t len)
+{
+    for (size_t iB=0; iB<len; iB++) {
+        hh ^= ((const unsigned char*)pData)[iB];
+        hh *= 1099511628211ULL;
+    }
+    return hh;
+}
+
+uint64_t Gameboard::stageHash(GEN_STAGE stage, uint64_t hh)
+{
+    switch (stage)
+    {
+        case STAGE_NOISE:
+        {
+            // Generator version, seed and dimensions feed every stage through the chain
+            int dims[6]      = { wRows, wCols, bRows, bCols, mRows, mCols };
+            int noiseOpts[4] = { tParams.noiseOcts, tParams.noiseFractal, tParams.climateOcts, tParams.elevMax };
+            hh = fnvBytes(hh, &genVersion, sizeof(genVersion));
+            hh = fnvBytes(hh, &seed,       sizeof(seed));
+            hh = fnvBytes(hh, dims,        sizeof(dims));
+            hh = fnvBytes(hh, &tParams.noiseFreq, sizeof(tParams.noiseFreq));
+            hh = fnvBytes(hh, noiseOpts,   sizeof(noiseOpts));
+            break;
+        }
+        case STAGE_FALLOFF:
+        {
+            int valley[3] = { wRadius, wOrig.x, wOrig.y };
+            hh = fnvBytes(hh, valley, sizeof(valley));
+            break;
+        }
+        case STAGE_EROSION:
+        {
+            const ErosionParams& ep = tParams.erosion;
+            int    eIters[3] = { ep.enabled, ep.hydroIters, ep.thermalIters };
+            double eRates[8] = { ep.rain, ep.kFlow, ep.kCapacity, ep.kErode, ep.kDeposit,
+                                 ep.kEvaporate, ep.talus, ep.thermalRate };
+            hh = fnvBytes(hh, eIters, sizeof(eIters));
+            hh = fnvBytes(hh, eRates, sizeof(eRates));
+            break;
+        }
+        case STAGE_CLASSIFY:
+        {
+            double threshs[7] = { tParams.threshT00, tParams.threshT01, tParams.threshT02,
+                                  tParams.threshT03, tParams.threshT04,
+                                  tParams.climateLo, tParams.climateHi };
+            hh = fnvBytes(hh, threshs, sizeof(threshs));
+            break;
+        }
+        case STAGE_RIVERS:
+        {
+            int rvrOpts[4] = { numRivers, riverWidth, bPos.x, bPos.y };
+            hh = fnvBytes(hh, rvrOpts,        sizeof(rvrOpts));
+            hh = fnvBytes(hh, &rvrElevWeight, sizeof(rvrElevWeight));
+            break;
+        }
+        case STAGE_DENSITY:
+            for (vector<SpawnRule>::iterator iRule=spawnTable.begin(); iRule!=spawnTable.end(); iRule++)
             {
-                //printf("DEBUG: Gameboard::checkNPCs distance of %1c from player is %6.2f\n",(*iNPC)->getType(),euclidean_dist(playerPos, (*iNPC)->getPos())); fflush(stdout);
-                if ( euclidean_dist(playerPos, (*iNPC)->getPos()) < (vRows/2) ) {
-                    (*iNPC)->setActive(); }
-                else {
-                    (*iNPC)->setActive(false); }
+                unsigned char flags[2] = { iRule->npcType, (unsigned char)iRule->hostile };
+                hh = fnvBytes(hh, flags,            sizeof(flags));
+                hh = fnvBytes(hh, &iRule->moveProb, sizeof(iRule->moveProb));
+                hh = fnvBytes(hh, iRule->density,   sizeof(iRule->density));
+                hh = fnvBytes(hh, &iRule->minDist,  sizeof(iRule->minDist));
             }
+            break;
+        default:
+            break;
+    }
+
+    return hh;
+}
+
+uint64_t Gameboard::getGenHash()
+{
+    // The key of the last stage covers every stage's params
+    uint64_t hh = 14695981039346656037ULL;
+    for (int iS=0; iS<MAX_STAGE; iS++) {
+        hh = stageHash((GEN_STAGE)iS, hh); }
+
+    return hh;
+}
 
-            ++iNPC;
+uint64_t Gameboard::getContentHash()
+{
+    uint64_t hh = 14695981039346656037ULL;
+    for (int jj=0; jj<mRows; jj++)
+    {
+        for (int ii=0; ii<mCols; ii++)
+        {
+            unsigned char tCell[2] = { (unsigned char)getTile(jj,ii).getElev(),
+                                       getTile(jj,ii).getTerrain() };
+            hh = fnvBytes(hh, tCell, sizeof(tCell));
+        }
+    }
+
+    for (int iN=0; iN<npcs.size(); iN++)
+    {
+        int npcRec[3] = { npcs.pos[iN].x, npcs.pos[iN].y, npcs.type[iN] };
+        hh = fnvBytes(hh, npcRec, sizeof(npcRec));
+    }
+
+    return hh;
+}
+
+NPCStore* Gameboard::getNPCs()
+{
+    return &npcs;
+}
+
+int Gameboard::addNPC(int x, int y, unsigned char npcT, bool isHstl, double moveP)
+{
+    int iN = npcs.add(x, y, npcT, isHstl, moveP);
+    getTile(y,x).setNPC(iN);
+    return iN;
+}
+
+void Gameboard::checkNPCs(bLoc playerPos)
+{
+    // Remove NPCs killed since the last check
+    npcs.reap();
+
+    // NPCs wake inside wakeRad but only sleep beyond sleepRad, so one at
+    // the edge doesn't flip every turn
+    // TODO: refine criteria for activate/inactivate NPCs
+    int wakeRad  = vRows/2;
+    int sleepRad = wakeRad + NPCStore::gridSize;
+
+    // Active NPCs that ended up too far from the player go dormant
+    for (size_t iA=0; iA<npcs.actv.size();)
+    {
+        bLoc dLoc = npcs.pos[npcs.actv[iA]]-playerPos;
+        if ((dLoc.x*dLoc.x + dLoc.y*dLoc.y) >= sleepRad*sleepRad) {
+            npcs.deactivate(npcs.actv[iA]); }
+        else {
+            ++iA; }
+    }
+
+    // Dormant NPCs don't move, so they only need waking when the player
+    // enters another grid cell (only those that actually move)
+    int pCell = npcs.cellOf(playerPos);
+    if (pCell != npcs.actvCell)
+    {
+        npcs.actvCell = pCell;
+        npcs.inRadius(playerPos, wakeRad, nearNPCs);
+        for (int iN : nearNPCs)
+        {
+            //printf("DEBUG: Gameboard::checkNPCs %1c is near the player\n",npcs.type[iN]); fflush(stdout);
+            if ((npcs.actvIdx[iN] < 0) && (npcs.moveProb[iN] > 1e-6)) {
+                npcs.activate(iN); }
         }
     }
 }
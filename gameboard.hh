@@ -20,59 +20,169 @@
 #include <cmath>
 #include <algorithm>
 #include <random>
+#include <cstdint>
+#include <chrono>
 
 #include "rogrand.hh"
 #include "river.hh"
 #include "navigator.hh"
 #include "tile.hh"
 #include "pawn.hh"
+#include "npc.hh"
+#include "terrain.hh"
 
 #include "FastNoiseLite.h"
 
 using namespace rogrand;
 
+// Generator version, part of the chunk cache key (see Gameboard::getGenHash).
+// Bump whenever a change to generation code alters the generated output.
+static const unsigned int genVersion = 4;
+
+// Largest supported dimension (rows or cols) for world, board and view
+static const int maxDim = 8192;
+
 // World Size
-static const int wRows = 64;
-static const int wCols = 64;
-static const int wRadius = sqrt(((wRows/2)^2)+((wCols/2)^2));
+extern int wRows;
+extern int wCols;
+extern int wRadius;
 
 // Board Size
-static const int bRows = 64;
-static const int bCols = 64;
-static const int bRadius = sqrt(((bRows/2)^2)+((bCols/2)^2));
+extern int bRows;
+extern int bCols;
+extern int bRadius;
 
 // Viewable Size
-static const int vRows = 64;
-static const int vCols = 64;
-static const int vRadius = sqrt(((vRows/2)^2)+((vCols/2)^2));
+extern int vRows;
+extern int vCols;
+extern int vRadius;
+
+// Tile storage layout of the world (set at startup, see TILE_LAYOUT)
+extern TILE_LAYOUT tileLayout;
+
+// Set world, board and viewable dimensions at startup (before any Gameboard
+// is created). Returns false and leaves dimensions unchanged if invalid.
+bool setDimensions(int wR, int wC, int bR, int bC, int vR, int vC);
+
+// Terrain generation stages, in run order (see Gameboard::runPipeline)
+enum GEN_STAGE {STAGE_NOISE, STAGE_FALLOFF, STAGE_EROSION, STAGE_CLASSIFY, STAGE_RIVERS, STAGE_DENSITY, MAX_STAGE};
+static const char* const stageNames[MAX_STAGE] = {"noise", "falloff", "erosion", "classify", "rivers", "density"};
+
+// Intermediate generation layers (row-major, mRows x mCols). Each stage
+// reads only earlier layers, so a parameter change reruns its own stage and
+// the ones after it, starting from the cached layers before it.
+struct GenLayers {
+    vector<double>        noiseElev;            // STAGE_NOISE    raw noise elevation
+    vector<unsigned char> climate;              // STAGE_NOISE    climate bin
+    vector<double>        shapedElev;           // STAGE_FALLOFF  valley shaped elevation
+    vector<double>        elevF;                // STAGE_EROSION  final raw elevation
+    vector<unsigned char> elevClass;            // STAGE_CLASSIFY elevation class
+    vector<unsigned char> biome;                // STAGE_CLASSIFY biome
+    vector<unsigned char> riverMask;            // STAGE_RIVERS   0 = dry, else carved elevation+1
+    vector<double>        density;              // STAGE_DENSITY  spawns per tile, per spawn rule
+    uint64_t              stageKey[MAX_STAGE] = {0};  // params each layer was built with
+};
+
+// Generation timings in milliseconds (see bench.cc), 0 for stages not run
+struct GenTimes {
+    double stage[MAX_STAGE] = {0.0};
+    double autotile = 0.0;
+    double entities = 0.0;
+};
+
+// Neighbor bits of Tile::getNbrMask (set if that neighbor's elevation differs)
+enum NBR_BIT {
+    NBR_N  = 0x01,
+    NBR_NE = 0x02,
+    NBR_E  = 0x04,
+    NBR_SE = 0x08,
+    NBR_S  = 0x10,
+    NBR_SW = 0x20,
+    NBR_W  = 0x40,
+    NBR_NW = 0x80 };
 
 // RMV class Worldboard;
+class ChunkCache;
 class River;
 class Tile;
+struct TileStore;
 class Pawn;
-class NPC;
+
+// Non-owning window onto a TileStore: the tile at [row,col] of the view
+// is store tile [row0+row, col0+col]
+struct BoardView {
+    TileStore* store  = nullptr;
+    int        row0   = 0;
+    int        col0   = 0;
+
+    Tile     at(int row, int col) const          {return Tile(store, store->index(row0+row, col0+col));};
+    uint64_t blockedBits(int row, int col) const {return store->blockedBits(row0+row, col0+col);};
+    uint64_t dirtyBits(int row, int col) const   {return store->dirtyBits(row0+row, col0+col);};
+};
+
+// Read-only copy of a board's tiles and occupancy at one moment (see
+// Gameboard::snapshot). Shares the world chunks covering the board, so it
+// is cheap to take (proportional to the board, not the world). Other
+// threads can read it without locks while the main loop keeps changing the
+// board. Occupants are Pawn indices only; the Pawns themselves are live.
+class BoardSnapshot
+{
+private:
+    shared_ptr<TileStore> store;
+    BoardView view;
+    int mRows = 0;
+    int mCols = 0;
+
+public:
+    BoardSnapshot() {};
+    BoardSnapshot(const BoardView& inView, int rows, int cols);
+
+    int      getRows()                        {return mRows;};
+    int      getCols()                        {return mCols;};
+    Tile     getTile(int row, int col)        {return view.at(row, col);};
+    uint64_t getBlockedBits(int row, int col) {return view.blockedBits(row, col);};
+    bool     getBlocked(int row, int col)     {return (0 != (view.blockedBits(row, col) & 1));};
+};
+
+// Rectangle of dirty tiles (board coordinates)
+struct DirtyRect {
+    int row;
+    int col;
+    int rows;
+    int cols;
+};
 
 class Gameboard
 {
 private:
-    // Terrain params
-    int    elevMax   = 1000;    // Maximum random elevation
-    double threshT00 = 0.000;   // Terrain threshold to be elevation 0, Deep Water
-    double threshT01 = 0.010;   // Terrain threshold to be elevation 1, Shallow Water
-    double threshT02 = 0.020;   // Terrain threshold to be elevation 2, Sand
-    double threshT03 = 0.450;   // Terrain threshold to be elevation 3, Dirt
-    double threshT04 = 0.820;   // Terrain threshold to be elevation 4, Mesa
-    //double threshT05 = 0.820;   // Terrain threshold to be elevation 5, Grass
-    //double threshT06 = 0.940;   // Terrain threshold to be elevation 6, Forest
-    //double threshT07 = 0.960;   // Terrain threshold to be elevation 7, Mountain
-    //double threshT08 = 0.980;   // Terrain threshold to be elevation 8, Snow
+    // Terrain params (copied from terrainParams at construction)
+    TerrainParams tParams;
 
     // Board Location in game "world"
     bLoc bPos;
 
-    //Tile Array
-    Tile* board[bRows][bCols];
-//    vector<vector<Tile*>> board;
+    // World location of tile [0,0] (generation samples world coordinates)
+    bLoc wOrig;
+
+    // Board dimensions (world or board size, fixed at construction)
+    int mRows;
+    int mCols;
+    int mRadius;
+
+    // Tile data (mRows x mCols, world only: it owns every tile)
+    TileStore tiles;
+
+    // Tiles of this board (the world's own array, or a section of it)
+    BoardView view;
+
+    // Board generation RNG, re-seeded per stage from derived sub-seeds
+    std::mt19937 bRng;
+
+    // Time spent in each generation stage
+    GenTimes genTimes;
+
+    // Cached generation layers (world only)
+    GenLayers layers;
 
     // River Data
     vector<DIRECTION> riversAvail;  // Directions available for river mouths
@@ -81,34 +191,96 @@ private:
     int numRivers = 2;              // Total # of rivers (flowing to center)
     int riverWidth = 3;             // River width and variation
 
-    // Create Elevation and Tile maps
-    bool createMap();
+    // Run the stages whose params changed since the layers were built,
+    // then everything after them. Returns the number of stages run.
+    int runPipeline();
 
-    // Place flora and fauna
-    void placeEntities();
+    // Hash of a stage's params, chained onto the previous stage's key
+    uint64_t stageHash(GEN_STAGE, uint64_t);
 
-    // Vector of all Pawns on the board
-    // TODO: implement ACTIVE and INACTIVE NPC vectors
-    vector<NPC*> bNPCs;
+    // Generation stages
+    void stageNoise();
+    void stageFalloff();
+    void stageErosion();
+    void stageClassify();
+    void stageRivers();
+    void stageDensity();
+
+    // Compute neighbor masks and corner elevations for every tile
+    void autotile();
+
+    // Place flora and fauna using the world's density layer
+    void placeEntities(Gameboard* inWorld);
+
+    // NPCs on this board
+    NPCStore npcs;
+    vector<int> nearNPCs;       // checkNPCs scratch
 
 public:
 
-    //Constructor & Destructor
-    Gameboard(int locX, int locY, Gameboard* inWorld=nullptr);
+    //Constructor & Destructor (boards are loaded from/saved to cache if given)
+    Gameboard(int locX, int locY, Gameboard* inWorld=nullptr, ChunkCache* cache=nullptr);
     ~Gameboard();
 
     //Accessor Methods
     bLoc  getBoardPos() {return bPos;};
     int   getBoardX()   {return bPos.x;};
     int   getBoardY()   {return bPos.y;};
-    int   getRows()     {return bRows;};
-    int   getCols()     {return bCols;};
-    Tile* getTile(int, int);
-
-    vector<NPC*>* getNPCs();
-    void          checkNPCs(bLoc);
-    //vector<NPC*>* addNPC( NPC*, int, int );         // TODO: implement this...
-    //vector<NPC*>* rmvNPC(vector<NPC*>::iterator);   // TODO: implement this...
+    int   getRows()     {return mRows;};
+    int   getCols()     {return mCols;};
+    Tile  getTile(int row, int col) {return view.at(row, col);};
+    bool  ownsTiles()               {return (view.store == &tiles);};   // World only
+
+    // Passability bitboard: blocked bits of columns [col, col+64) of a row
+    // (bit 0 is col). Bits past the board's right edge must be masked off.
+    uint64_t getBlockedBits(int row, int col) {return view.blockedBits(row, col);};
+    bool     getBlocked(int row, int col)     {return (0 != (view.blockedBits(row, col) & 1));};
+
+    // Unblocked tiles: count them, or find the k-th in row-major order ({-1,-1} if none)
+    int   countFree();
+    bLoc  getFree(int kk);
+
+    // View of this board's tiles starting at [row,col] (stays valid while the board lives)
+    BoardView getView(int row, int col);
+
+    // All tiles of the blkSize x blkSize block holding [row,col] are blocked,
+    // in O(1). Blocks are aligned to the world, not to this board.
+    bool  getBlockBlocked(int row, int col) {return view.store->blockBlocked(view.row0+row, view.col0+col);};
+
+    // Tile storage held in memory vs the same arrays stored densely (bytes)
+    size_t getResidentBytes() {return view.store->residentBytes();};
+    size_t getDenseBytes()    {return view.store->denseBytes();};
+
+    // Consistent copy of this board's tiles for concurrent readers
+    BoardSnapshot snapshot() {return BoardSnapshot(view, mRows, mCols);};
+
+    // Batch tile writes: flags are recomputed once over the touched tiles at
+    // endEdit rather than on every write (occupancy is stale in between)
+    void  beginEdit() {view.store->beginEdit();};
+    void  endEdit()   {view.store->endEdit();};
+
+    // Dirty tiles (changed since last render): mark or clear a rectangle,
+    // or coalesce the board's dirty tiles into rectangles (row-major)
+    void  setDirty(int row, int col, int rows, int cols, bool isDirty);
+    void  getDirtyRects(vector<DirtyRect>& rects);
+
+    // Hash of everything that determines generated output (cache key)
+    uint64_t getGenHash();
+
+    // Change terrain params on the world, rerunning only the affected
+    // stages. Returns the number of stages run.
+    int regenerate(const TerrainParams&);
+
+    // Spawn density of a spawn rule at a world location (world only)
+    double getDensity(int rule, int row, int col) {return layers.density[(rule*mRows+row)*mCols+col];};
+
+    // Hash of the generated content (elevations and NPCs)
+    uint64_t getContentHash();
+    GenTimes getGenTimes() {return genTimes;};
+
+    NPCStore* getNPCs();
+    void      checkNPCs(bLoc);
+    int       addNPC(int x, int y, unsigned char npcT, bool isHstl, double moveP);
 };
 
 // RMV class Worldboard : public Gameboard
@@ -4,12 +4,13 @@
 
 #include "gamemaster.hh"
 
-Gamemaster::Gamemaster()
+Gamemaster::Gamemaster(const string& cacheDir)
 {
     init();
 
-    // Create the world and game boards
-    worldBoard = new Gameboard(-1,-1);
+    // Create the world and game boards (reusing cached boards when possible)
+    chunkCache = new ChunkCache(cacheDir);
+    worldBoard = new Gameboard(-1,-1,nullptr,chunkCache);
 
     for (int jj=0; jj<(wRows/bRows); jj++)
     {
@@ -24,33 +25,11 @@ Gamemaster::Gamemaster()
 
     currNPCs = currBoard->getNPCs();
 
-    // Give pawns their textures
-    for (vector<NPC*>::iterator iNPC=currNPCs->begin(); iNPC!=currNPCs->end(); ++iNPC)
+    // Pick each cactus's look
+    for (int iN=0; iN<currNPCs->size(); iN++)
     {
-        switch ((*iNPC)->getType())
-        {
-            case '@':
-                (*iNPC)->setTexture(txtrCowboy);
-                break;
-            case 'b':
-                (*iNPC)->setTexture(txtrBandit);
-                break;
-            case 'm':
-                (*iNPC)->setTexture(txtrMesa);
-                break;
-            case 'c':
-                (*iNPC)->setTexture(txtrCactus[randI(0,2)]);
-                break;
-            case 'g':
-                (*iNPC)->setTexture(txtrGila);
-                break;
-            case 'w':
-                (*iNPC)->setTexture(txtrCow);
-                break;
-            default:
-                (*iNPC)->setTexture(txtrError);
-                break;
-        }
+        if ('c' == currNPCs->type[iN]) {
+            currNPCs->look[iN] = randI(0,2); }
     }
 }
 
@@ -59,12 +38,35 @@ Gamemaster::~Gamemaster()
     //printf("DEBUG: Begin Gamemaster destructor.\n");
     deletePlayer();
 
-    // Delete game board
+    // Delete game boards, then the world that owns their tiles
     for (iBoard=mBoard.begin(); iBoard!=mBoard.end(); iBoard++) {
         delete (*iBoard);
     }
     mBoard.clear();
 
+    delete worldBoard;
+    worldBoard = nullptr;
+
+    delete chunkCache;
+    chunkCache = nullptr;
+
+    if (nullptr != txtrOverview) {
+        SDL_DestroyTexture(txtrOverview);
+        txtrOverview = nullptr;
+    }
+
+    if (nullptr != txtrFrame) {
+        SDL_DestroyTexture(txtrFrame);
+        txtrFrame = nullptr;
+    }
+
+    for (int iV=0; iV<numVariants; iV++) {
+        if (nullptr != txtrVariant[iV]) {
+            SDL_DestroyTexture(txtrVariant[iV]);
+            txtrVariant[iV] = nullptr;
+        }
+    }
+
     // Destroy window
     SDL_DestroyRenderer( gRenderer );
     gRenderer = nullptr;
@@ -124,6 +126,9 @@ int Gamemaster::init()
     //Load Textures
     SDL_Surface* srfcTemp = nullptr;
 
+    for (int iV=0; iV<numVariants; iV++) {
+        txtrVariant[iV] = nullptr; }
+
     // Tile/Terrain Textures (by elevation)
     for (int iT=0; iT<numTxtrs; iT++) {
         char strTerr [256];
@@ -215,6 +220,9 @@ int Gamemaster::init()
     txtrError = SDL_CreateTextureFromSurface( gRenderer, srfcTemp );
     SDL_FreeSurface( srfcTemp );
 
+    tileSizeFOV   = std::max(1, WINDOW_HEIGHT/vRows);
+    tileSizeBOARD = std::max(1, WINDOW_HEIGHT/bRows);
+
     if (RENDER_FOV) {
         tileSize = tileSizeFOV; }
     else {
@@ -233,71 +241,114 @@ int Gamemaster::getTileSize()
     return tileSize;
 }
 
-void Gamemaster::renderTile( Tile* tile )
+void Gamemaster::renderTile( Tile tile )
 {
-    if (tile->getFresh() || RENDER_FOV)
+    // Tiles whose neighbors all share its elevation have no corners
+    SDL_Texture* tTxtr = txtrTerr[tile.getElev()];
+    if (0 != tile.getNbrMask()) {
+        tTxtr = getTileVariant(tile);
+    }
+
+    //// DEBUG: For testing tile occupied status
+    //if (tile.getOccupied()) {tTxtr = txtrError;}
+
+    SDL_Rect tRect;
+    tRect = { (tile.getX()+adjX)*tileSize, (tile.getY()+adjY)*tileSize, tileSize, tileSize };
+    SDL_RenderCopy( gRenderer, tTxtr, nullptr, &(tRect) );
+}
+
+SDL_Texture* Gamemaster::getTileVariant( Tile tile )
+{
+    // iVar = elev + numTxtrs*(NE + numTxtrs*(SE + numTxtrs*(SW + numTxtrs*NW)))
+    int  tElev   = tile.getElev();
+    int  iVar    = 0;
+    bool hasCrnr = false;
+    for (int iC=MAX_IC-1; iC>=0; iC--) {
+        iVar    = iVar*numTxtrs + tile.getCrnr(iC);
+        hasCrnr = hasCrnr || (tile.getCrnr(iC) != tElev); }
+    iVar = iVar*numTxtrs + tElev;
+
+    // Neighbors differ, but not in a way that rounds any corner
+    if (!hasCrnr) {
+        return txtrTerr[tElev]; }
+
+    if (nullptr == txtrVariant[iVar])
     {
-        //SDL_Texture* tTxtr = nullptr;
-        //if ((tile->getElev()>=0) && (tile->getElev()<numTxtrs))
-        //{
-        //    tTxtr = txtrTerr[tile->getElev()];
-        //}
-        //else
-        //{
-        //    tTxtr = txtrError;
-        //}
-        SDL_Texture* tTxtr = txtrTerr[tile->getElev()];
-
-        //// DEBUG: For testing tile occupied status
-        //if (tile->getOccupied()) {tTxtr = txtrError;}
-
-        if (RENDER_FOV)
-        {
-            adjX = -player->getX()+(vCols/2);
-            adjY = -player->getY()+(vRows/2);
+        // Composite the terrain and its differing corners into one texture
+        int tW = 0;
+        int tH = 0;
+        SDL_QueryTexture( txtrTerr[tElev], nullptr, nullptr, &tW, &tH );
+
+        SDL_Texture* vTxtr = SDL_CreateTexture( gRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, tW, tH );
+        if (nullptr == vTxtr) {
+            // Render targets unsupported, fall back to the plain terrain
+            return txtrTerr[tElev];
         }
+        SDL_SetTextureBlendMode( vTxtr, SDL_BLENDMODE_BLEND );
 
-        SDL_Rect tRect;
-        tRect = { (tile->getX()+adjX)*tileSize, (tile->getY()+adjY)*tileSize, tileSize, tileSize };
-        SDL_RenderCopy( gRenderer, tTxtr, nullptr, &(tRect) );
-
-/*
-        // Render tiles's corners
+        // May be called while drawing into the frame texture
+        SDL_Texture* prevTarget = SDL_GetRenderTarget( gRenderer );
+        SDL_SetRenderTarget( gRenderer, vTxtr );
+        SDL_RenderCopy( gRenderer, txtrTerr[tElev], nullptr, nullptr );
         for (int iC=0; iC<MAX_IC; iC++) {
-            //printf("DEBUG: Getting corner texture at index: %2d\n",tile->getElev()*MAX_IC+tile->getCrnr(iC)); fflush(stdout);
-            SDL_Texture* cTxtr = txtrCrnr[tile->getCrnr(iC)*MAX_IC+iC];
-
-            SDL_Rect cRect;
-            cRect = { (tile->getX()+adjX)*tileSize, (tile->getY()+adjY)*tileSize,tileSize, tileSize };
-            SDL_RenderCopy( gRenderer, cTxtr, nullptr, &(cRect) );
+            if (tile.getCrnr(iC) != tElev) {
+                SDL_RenderCopy( gRenderer, txtrCrnr[tile.getCrnr(iC)*MAX_IC+iC], nullptr, nullptr );
+            }
         }
-*/
+        SDL_SetRenderTarget( gRenderer, prevTarget );
 
-        tile->setFresh(false);
+        txtrVariant[iVar] = vTxtr;
     }
+
+    return txtrVariant[iVar];
 }
 
 void Gamemaster::renderPawn( Pawn* pwn )
 {
-    if (RENDER_FOV)
-    {
-        adjX = -player->getX()+(vCols/2);
-        adjY = -player->getY()+(vRows/2);
-    }
-
     SDL_Rect tRect;
     tRect = { (pwn->getX()+adjX)*tileSize, (pwn->getY()+adjY)*tileSize, tileSize, tileSize };
     SDL_RenderCopy( gRenderer, pwn->getTexture(), nullptr, &(tRect) );
 }
 
-Pawn* Gamemaster::addPlayer()
+void Gamemaster::renderNPC( NPCStore* npcs, int iN )
+{
+    SDL_Rect tRect;
+    tRect = { (npcs->pos[iN].x+adjX)*tileSize, (npcs->pos[iN].y+adjY)*tileSize, tileSize, tileSize };
+    SDL_RenderCopy( gRenderer, getNPCTexture(npcs->type[iN], npcs->look[iN]), nullptr, &(tRect) );
+}
+
+SDL_Texture* Gamemaster::getNPCTexture( unsigned char npcT, int look )
 {
-    int tmpX, tmpY;
-    do
+    switch (npcT)
     {
-        tmpX = randI(0,bCols-1);
-        tmpY = randI(0,bRows-1);
-    } while ( currBoard->getTile(tmpY,tmpX)->getOccupied() );
+        case '@':
+            return txtrCowboy;
+        case 'b':
+            return txtrBandit;
+        case 'm':
+            return txtrMesa;
+        case 'c':
+            return txtrCactus[look];
+        case 'g':
+            return txtrGila;
+        case 'w':
+            return txtrCow;
+        default:
+            return txtrError;
+    }
+}
+
+Pawn* Gamemaster::addPlayer()
+{
+    // Pick uniformly among the unblocked tiles (no rejection loop)
+    int numFree = currBoard->countFree();
+    if (numFree <= 0) {
+        printf("ERROR: No free tile for the player on board [%2d,%2d].\n", currBoard->getBoardX(), currBoard->getBoardY()); fflush(stdout);
+        return nullptr; }
+
+    bLoc pLoc = currBoard->getFree(randI(0,numFree-1));
+    int  tmpX = pLoc.x;
+    int  tmpY = pLoc.y;
 
     player = new Pawn( currBoard, tmpX, tmpY );
     player->setPlayer();
@@ -305,14 +356,17 @@ Pawn* Gamemaster::addPlayer()
 
     player->setTexture(txtrCowboy);
 
-    currBoard->getTile(tmpY,tmpX)->setPawn(player);
+    currBoard->getTile(tmpY,tmpX).setPawn(player);
 
     return player;
 }
 
 void Gamemaster::deletePlayer()
 {
-    currBoard->getTile(player->getY(),player->getX())->rmvPawn();
+    if (nullptr == player) {
+        return; }
+
+    currBoard->getTile(player->getY(),player->getX()).rmvOccupant();
     delete player;
     player = nullptr;
 }
@@ -320,7 +374,7 @@ void Gamemaster::deletePlayer()
 Gameboard* Gamemaster::addBoard(int toX, int toY)
 {
     // TODO: determine if player should gain xp for exploring new boards
-    mBoard.push_back(new Gameboard(toX, toY, worldBoard));
+    mBoard.push_back(new Gameboard(toX, toY, worldBoard, chunkCache));
     return mBoard.back();
 }
 
@@ -334,6 +388,7 @@ void Gamemaster::setBoard(Gameboard* toBoard)
     currBoard = toBoard;
     wPos      = currBoard->getBoardPos();
     currNPCs  = currBoard->getNPCs();
+    redrawAll = true;
     if (nullptr!=player)
     {
         player->setBoard(currBoard);
@@ -353,25 +408,97 @@ void Gamemaster::renderBoard()
 
 void Gamemaster::renderBoard(Gameboard* rndrBoard)
 {
+    if (RENDER_OVERVIEW)
+    {
+        renderOverview();
+        return;
+    }
+
+    if (nullptr == rndrBoard) { // Render a blank board if nullptr is passed
+        SDL_RenderClear( gRenderer );
+        SDL_RenderPresent( gRenderer );
+        redrawAll = true;
+        return;
+    }
+
+    int rows = rndrBoard->getRows();
+    int cols = rndrBoard->getCols();
+
+    // The field of view follows the player, so a move shifts every visible tile
+    if (RENDER_FOV && (nullptr != player))
+    {
+        int newAdjX = -player->getX()+(vCols/2);
+        int newAdjY = -player->getY()+(vRows/2);
+        redrawAll = redrawAll || (newAdjX != adjX) || (newAdjY != adjY);
+        adjX = newAdjX;
+        adjY = newAdjY;
+    }
+
+    // Visible window in board coordinates
+    int winRow0 = 0;
+    int winCol0 = 0;
+    int winRow1 = rows;
+    int winCol1 = cols;
     if (RENDER_FOV)
     {
-        //Clear screen, render texture, update screen
-        //printf("DEBUG: Begin renderBoard. Turn: %4d\n", turnCount);
+        winRow0 = std::max(0, -adjY);
+        winCol0 = std::max(0, -adjX);
+        winRow1 = std::min(rows, vRows-adjY);
+        winCol1 = std::min(cols, vCols-adjX);
+    }
+
+    // (Re)create the frame texture if the renderer output changed size
+    int outW = 0;
+    int outH = 0;
+    SDL_GetRendererOutputSize( gRenderer, &outW, &outH );
+    if ((nullptr == txtrFrame) || (outW != frameW) || (outH != frameH))
+    {
+        if (nullptr != txtrFrame) {
+            SDL_DestroyTexture(txtrFrame); }
+        txtrFrame = SDL_CreateTexture( gRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, outW, outH );
+        frameW    = outW;
+        frameH    = outH;
+        redrawAll = true;
+    }
+
+    // Without a frame texture, draw everything straight to the window
+    if (nullptr == txtrFrame) {
+        redrawAll = true; }
+    SDL_SetRenderTarget( gRenderer, txtrFrame );
+
+    if (redrawAll)
+    {
+        //printf("DEBUG: Redraw all. Turn: %4d\n", turnCount);
         SDL_RenderClear( gRenderer );
+        rndrBoard->setDirty(winRow0, winCol0, winRow1-winRow0, winCol1-winCol0, true);
+        redrawAll = false;
     }
 
-    if (nullptr != rndrBoard) { // Render a blank board if nullptr is passed
-        for (int jj=0; jj<bRows; jj++) {
-            for (int ii=0; ii<bCols; ii++) {
-                renderTile(rndrBoard->getTile(jj,ii));
+    // Draw only the tiles changed since the last present
+    rndrBoard->getDirtyRects(dirtyRects);
+    for (const DirtyRect& dRect : dirtyRects)
+    {
+        for (int jj=std::max(dRect.row, winRow0); jj<std::min(dRect.row+dRect.rows, winRow1); jj++) {
+            for (int ii=std::max(dRect.col, winCol0); ii<std::min(dRect.col+dRect.cols, winCol1); ii++) {
+                Tile tTile = rndrBoard->getTile(jj,ii);
+                renderTile(tTile);
 
-                if (rndrBoard->getTile(jj,ii)->hasPawn()) {
-                    renderPawn(rndrBoard->getTile(jj,ii)->getPawn());
+                if (nullptr != tTile.getPawn()) {
+                    renderPawn(tTile.getPawn());
+                }
+                else if (tTile.getNPC() >= 0) {
+                    renderNPC(rndrBoard->getNPCs(), tTile.getNPC());
                 }
             }
         }
     }
 
+    // Changes outside the window are drawn when the view scrolls onto them
+    rndrBoard->setDirty(0, 0, rows, cols, false);
+
+    SDL_SetRenderTarget( gRenderer, nullptr );
+    if (nullptr != txtrFrame) {
+        SDL_RenderCopy( gRenderer, txtrFrame, nullptr, nullptr ); }
     SDL_RenderPresent( gRenderer );
     //printf("DEBUG: End renderBoard.\n");
 }
@@ -393,24 +520,95 @@ void Gamemaster::swapRenderMode()
         adjY = 0;
     }
 
-    for (int jj=0; jj<bRows; jj++) {
-        for (int ii=0; ii<bCols; ii++) {
-            currBoard->getTile(jj,ii)->setFresh();
-        }
+    redrawAll = true;
+    renderBoard();
+}
+
+void Gamemaster::swapOverviewMode()
+{
+    RENDER_OVERVIEW = !RENDER_OVERVIEW;
+
+    if (!RENDER_OVERVIEW)
+    {
+        // Tiles were drawn over, redraw all of them
+        redrawAll = true;
     }
     renderBoard();
 }
 
+void Gamemaster::renderOverview()
+{
+    // Overview colors by elevation class (RGBA8888)
+    static const Uint32 elevColor[numElevs] = {
+        0x1F4E8CFF,     // 0 Deep Water
+        0x4A90C8FF,     // 1 Shallow Water
+        0xE6C88AFF,     // 2 Sand
+        0xC28A4EFF,     // 3 Dirt
+        0x8C4A2EFF };   // 4 Mesa
+
+    if (nullptr == txtrOverview)
+    {
+        // Sample the world at a stride that fits the window (no Tiles created)
+        clock_t tStart = clock();
+        overviewStride = std::max(1, (std::max(wRows,wCols)+WINDOW_HEIGHT-1)/WINDOW_HEIGHT);
+
+        vector<unsigned char> oElev;
+        int oRows = 0;
+        int oCols = 0;
+        createOverview(terrainParams, wRows, wCols, wRadius, overviewStride, oElev, oRows, oCols);
+
+        vector<Uint32> oPix(oRows*oCols);
+        for (size_t iP=0; iP<oPix.size(); iP++) {
+            oPix[iP] = elevColor[std::min((int)oElev[iP], numElevs-1)];
+        }
+
+        txtrOverview = SDL_CreateTexture( gRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC, oCols, oRows );
+        if (nullptr == txtrOverview) {
+            printf("ERROR: Unable to create overview texture! SDL Error: %s\n", SDL_GetError()); fflush(stdout);
+            RENDER_OVERVIEW = false;
+            return;
+        }
+        SDL_UpdateTexture( txtrOverview, nullptr, &oPix[0], oCols*sizeof(Uint32) );
+
+        printf("INFO: World overview [%dx%d] at stride %d generated in %.2f ms\n",
+               oCols, oRows, overviewStride, 1000.0*(clock()-tStart)/CLOCKS_PER_SEC); fflush(stdout);
+    }
+
+    // Scale the overview to the window, keeping the world aspect ratio
+    double oScale = std::min((double)WINDOW_WIDTH/wCols, (double)WINDOW_HEIGHT/wRows);
+    SDL_Rect oRect = { 0, 0, (int)(wCols*oScale), (int)(wRows*oScale) };
+
+    SDL_RenderClear( gRenderer );
+    SDL_RenderCopy( gRenderer, txtrOverview, nullptr, &oRect );
+
+    // Mark the current board and the player
+    if (nullptr != currBoard)
+    {
+        SDL_Rect bRect = { (int)(wPos.x*bCols*oScale), (int)(wPos.y*bRows*oScale),
+                           std::max(1,(int)(bCols*oScale)), std::max(1,(int)(bRows*oScale)) };
+        SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0x40 );
+        SDL_RenderFillRect( gRenderer, &bRect );
+
+        if (nullptr != player)
+        {
+            SDL_Rect pRect = { (int)((wPos.x*bCols+player->getX())*oScale)-2,
+                               (int)((wPos.y*bRows+player->getY())*oScale)-2, 5, 5 };
+            SDL_SetRenderDrawColor( gRenderer, 0xFF, 0x00, 0x00, 0xFF );
+            SDL_RenderFillRect( gRenderer, &pRect );
+        }
+        SDL_SetRenderDrawColor( gRenderer, 0x00, 0xFF, 0x00, 0xFF );
+    }
+
+    SDL_RenderPresent( gRenderer );
+}
+
 void Gamemaster::update()
 {
     // Remove NPCs with with <=0 life
     currBoard->checkNPCs(player->getPos());
 
-    // Tell each NPC to "do your thing"
-    // TODO: Consider adding a method to Gameboard to handle the dyt of its bNPCs
-    for (vector<NPC*>::iterator iNPC=currNPCs->begin(); iNPC!=currNPCs->end(); ++iNPC) {
-        (*iNPC)->dyt(player->getPos());
-    }
+    // Tell each active NPC to "do your thing"
+    currNPCs->takeTurn(player->getPos());
 
     turnCount++;
 }
@@ -436,16 +634,12 @@ void Gamemaster::toPrint()
     //printf("DEBUG: Gamemaster::toPrint Xspan = %4d\n",Xspan);
     //printf("DEBUG: Gamemaster::toPrint Yspan = %4d\n",Yspan); fflush(stdout);
 
-    // Generate a 2D world map array, initialize to 0, and populate with existing boards
-    int wMap[Yspan][Xspan];
-    for (int ii=0; ii<Yspan; ii++) {
-        for (int jj=0; jj<Xspan; jj++) {
-             wMap[ii][jj] = 0;
-        }
-    }
+    // Generate a 2D world map array (row-major, Yspan x Xspan), initialize to 0,
+    // and populate with existing boards
+    vector<int> wMap(Yspan*Xspan, 0);
 
     for (iBoard=mBoard.begin(); iBoard!=mBoard.end(); iBoard++) {
-        wMap[(*iBoard)->getBoardY()-Ymin][(*iBoard)->getBoardX()-Xmin] = 1;
+        wMap[((*iBoard)->getBoardY()-Ymin)*Xspan+((*iBoard)->getBoardX()-Xmin)] = 1;
     }
 
     // Print the "world map" to the terminal
@@ -456,10 +650,10 @@ void Gamemaster::toPrint()
     for (int ii=0; ii<Yspan; ii++) {
         printf("    ");
         for (int jj=0; jj<Xspan; jj++) {
-             if (0 == wMap[ii][jj]) {
+             if (0 == wMap[ii*Xspan+jj]) {
                 printf(" ");
              }
-             else if (1 == wMap[ii][jj]) {
+             else if (1 == wMap[ii*Xspan+jj]) {
                 printf("x");
              }
 
@@ -470,6 +664,22 @@ void Gamemaster::toPrint()
         printf("\n");
     }
 
+    // Print a coarse elevation overview of the whole world (at most 64 wide)
+    static const char elevChar[numElevs] = { '~', '-', '.', ',', '^' };
+    vector<unsigned char> oElev;
+    int oRows  = 0;
+    int oCols  = 0;
+    int stride = std::max(1, (wCols+63)/64);
+    createOverview(terrainParams, wRows, wCols, wRadius, stride, oElev, oRows, oCols);
+    printf("\nWorld Overview [%dx%d, 1:%d]:\n\n",oCols,oRows,stride);
+    for (int ii=0; ii<oRows; ii++) {
+        printf("    ");
+        for (int jj=0; jj<oCols; jj++) {
+            printf("%c",elevChar[std::min((int)oElev[ii*oCols+jj], numElevs-1)]);
+        }
+        printf("\n");
+    }
+
     // Save screenshots of the boards
     for (iBoard=mBoard.begin(); iBoard!=mBoard.end(); iBoard++) {
         //printf("DEBUG: world_%04dx%04d.bmp\n",(*iBoard)->getBoardX()-Xmin,(*iBoard)->getBoardY()-Ymin); fflush(stdout);
@@ -15,6 +15,7 @@
 
 #include "rogrand.hh"
 #include "gameboard.hh"
+#include "chunkcache.hh"
 #include "navigator.hh"
 #include "tile.hh"
 #include "pawn.hh"
@@ -32,10 +33,10 @@ private:
     // Turn counter
     int turnCount;
 
-    //Tile size (side length in pixels)
-    static const int tileSizeFOV   = WINDOW_HEIGHT/vRows;
-    static const int tileSizeBOARD = WINDOW_HEIGHT/bRows;
-    int tileSize = tileSizeFOV;
+    //Tile size (side length in pixels, set in init() from board/view dims)
+    int tileSizeFOV   = 1;
+    int tileSizeBOARD = 1;
+    int tileSize      = 1;
     int adjX     = 0;
     int adjY     = 0;
 
@@ -44,6 +45,13 @@ private:
     SDL_Texture* txtrTerr[numTxtrs];    // Terrain Textures
     SDL_Texture* txtrCrnr[numTxtrs*MAX_IC];  // Corner Textures (4 per terrain level)
 
+    // Precomposited terrain + corner textures, created on first use. Index is
+    // the tile elevation and its 4 corner elevations as base numTxtrs digits.
+    static const int numVariants = numTxtrs*numTxtrs*numTxtrs*numTxtrs*numTxtrs;
+    SDL_Texture* txtrVariant[numVariants];
+    SDL_Texture* getTileVariant(Tile);
+    SDL_Texture* getNPCTexture(unsigned char, int);
+
     SDL_Texture* txtrDesert;
     SDL_Texture* txtrMesa;
     SDL_Texture* txtrAgua;
@@ -59,23 +67,45 @@ private:
     //  false = render full board (bRows x bCols)
     bool RENDER_FOV = true;
 
+    // Clear the screen and redraw the whole view on the next render
+    // (otherwise only dirty tiles are drawn)
+    bool redrawAll = true;
+    vector<DirtyRect> dirtyRects;   // Scratch for renderBoard
+
+    // The drawn board, kept between frames. Dirty tiles are drawn into it and
+    // it is copied to the window on every render, since the window's back
+    // buffer is undefined after a present. Sized to the renderer output and
+    // recreated when that changes (nullptr if render targets are unsupported,
+    // in which case every frame is drawn in full).
+    SDL_Texture* txtrFrame = nullptr;
+    int frameW = 0;
+    int frameH = 0;
+
+    // World overview (coarse elevation image of the whole world)
+    bool RENDER_OVERVIEW = false;
+    SDL_Texture* txtrOverview = nullptr;
+    int overviewStride = 1;     // World tiles per overview pixel
+
 public:
     // SDL window and renderer
     SDL_Window*     gWindow = nullptr;
     SDL_Renderer* gRenderer = nullptr;
 
-    //Constructor & Destructor
-    Gamemaster();
+    //Constructor & Destructor (an empty cacheDir disables the chunk cache)
+    Gamemaster(const string& cacheDir="cache");
     ~Gamemaster();
 
     // Initialize Gamemaster
     int init();
 
     //Render Objects
-    void renderTile( Tile* );
+    void renderTile( Tile );
     void renderPawn( Pawn* );
+    void renderNPC( NPCStore*, int );
     int  getTileSize();
     void swapRenderMode();
+    void swapOverviewMode();
+    void renderOverview();
 
     // Gamemaster Methods
     Gameboard* addBoard(int, int);
@@ -92,6 +122,9 @@ public:
     Pawn* addPlayer();
     void  deletePlayer();
 
+    // Cache of generated boards
+    ChunkCache* chunkCache;
+
     // Game Board
     Gameboard* worldBoard;
     Gameboard* currBoard;
@@ -103,7 +136,7 @@ public:
     Pawn* player;
 
     //Current NPCs
-    vector<NPC*>* currNPCs;
+    NPCStore* currNPCs;
 };
 
 #endif
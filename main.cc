@@ -24,16 +24,127 @@
 
 using namespace rogrand;
 
+/*
+ *  Command Line Usage
+ */
+void printUsage( const char* prog )
+{
+    printf("Usage: %s [options]\n", prog);
+    printf("    --world ROWS COLS   World dimensions in tiles    (default %d %d)\n", wRows, wCols);
+    printf("    --board ROWS COLS   Board dimensions in tiles    (default %d %d)\n", bRows, bCols);
+    printf("    --view  ROWS COLS   Viewable (FOV) dimensions    (default %d %d)\n", vRows, vCols);
+    printf("    --seed  SEED        Game seed for a reproducible world (default random)\n");
+    printf("    --cache DIR         Directory for cached boards  (default cache)\n");
+    printf("    --no-cache          Always generate boards, never read or write the cache\n");
+    printf("    --erode             Run hydraulic and thermal erosion on the terrain\n");
+    printf("    --layout NAME       Tile storage layout: rows or blocks (default %s)\n", layoutNames[tileLayout]);
+    printf("    --ai-budget N       NPCs that may search for a path per turn, 0 for no limit (default %d)\n", aiBudget);
+    printf("  Dimensions may be at most %d.\n", maxDim); fflush(stdout);
+}
+
 /*
  *  Main Program Loop
  */
 int main( int argc, char* args[] )
 {
+    // Parse command line options
+    int optWR = wRows, optWC = wCols;
+    int optBR = bRows, optBC = bCols;
+    int optVR = vRows, optVC = vCols;
+    std::string optCache = "cache";
+    for (int iArg=1; iArg<argc; iArg++)
+    {
+        std::string opt = args[iArg];
+        int* optR = nullptr;
+        int* optC = nullptr;
+
+        if (opt=="--seed")
+        {
+            if (iArg+1 >= argc)
+            {
+                printf("ERROR: --seed requires SEED.\n");
+                printUsage(args[0]);
+                return EXIT_FAILURE;
+            }
+            setSeed(strtoul(args[++iArg], nullptr, 0));
+            continue;
+        }
+        else if (opt=="--cache")
+        {
+            if (iArg+1 >= argc)
+            {
+                printf("ERROR: --cache requires DIR.\n");
+                printUsage(args[0]);
+                return EXIT_FAILURE;
+            }
+            optCache = args[++iArg];
+            continue;
+        }
+        else if (opt=="--no-cache")
+        {
+            optCache = "";
+            continue;
+        }
+        else if (opt=="--erode")
+        {
+            terrainParams.erosion.enabled = true;
+            continue;
+        }
+        else if (opt=="--layout")
+        {
+            std::string optLayout = (iArg+1 < argc) ? args[++iArg] : "";
+            if      (optLayout==layoutNames[LAYOUT_ROWS])   { tileLayout = LAYOUT_ROWS; }
+            else if (optLayout==layoutNames[LAYOUT_BLOCKS]) { tileLayout = LAYOUT_BLOCKS; }
+            else
+            {
+                printf("ERROR: --layout requires rows or blocks.\n");
+                printUsage(args[0]);
+                return EXIT_FAILURE;
+            }
+            continue;
+        }
+        else if (opt=="--ai-budget")
+        {
+            if (iArg+1 >= argc)
+            {
+                printf("ERROR: --ai-budget requires N.\n");
+                printUsage(args[0]);
+                return EXIT_FAILURE;
+            }
+            aiBudget = std::max(0, atoi(args[++iArg]));
+            continue;
+        }
+
+        if      (opt=="--world") { optR = &optWR; optC = &optWC; }
+        else if (opt=="--board") { optR = &optBR; optC = &optBC; }
+        else if (opt=="--view")  { optR = &optVR; optC = &optVC; }
+        else
+        {
+            printUsage(args[0]);
+            return EXIT_FAILURE;
+        }
+
+        if (iArg+2 >= argc)
+        {
+            printf("ERROR: %s requires ROWS and COLS.\n", opt.c_str());
+            printUsage(args[0]);
+            return EXIT_FAILURE;
+        }
+        *optR = atoi(args[++iArg]);
+        *optC = atoi(args[++iArg]);
+    }
+
+    if (!setDimensions(optWR, optWC, optBR, optBC, optVR, optVC))
+    {
+        printUsage(args[0]);
+        return EXIT_FAILURE;
+    }
+
     // Setup the random seed for this game
     printf("GAME SEED: %16u\n",seed); fflush(stdout);
 
     // Instantiate the Gamemaster (i.e. Dungeon Master)
-    Gamemaster* DM = new Gamemaster();
+    Gamemaster* DM = new Gamemaster(optCache);
 
     //Main loop flag
     bool quit = false;
@@ -43,6 +154,9 @@ int main( int argc, char* args[] )
 
     // Add Player to game
     Pawn* player1 = DM->addPlayer();
+    if (nullptr == player1) {
+        delete DM;
+        return EXIT_FAILURE; }
 
     // Initial rendering of game board
     DM->renderBoard();
@@ -51,7 +165,7 @@ int main( int argc, char* args[] )
     vector<bLoc> moveQ;
 
     //While application is running
-    while( (player1->getLP()>0) &&
+    while( (nullptr != player1) && (player1->getLP()>0) &&
            ((!moveQ.empty()) || (!quit && SDL_WaitEvent(&evnt))) )
     {
         bool updtBoard = false;
@@ -121,7 +235,7 @@ int main( int argc, char* args[] )
                         case SDLK_BACKSPACE:
                             DM->deletePlayer();
                             player1 = nullptr;
-                            player1 = DM->addPlayer();
+                            player1 = DM->addPlayer();   // nullptr ends the loop
                             break;
                         case SDLK_KP_PERIOD:
                         case SDLK_PERIOD:
@@ -130,6 +244,9 @@ int main( int argc, char* args[] )
                             printf("Total Experience = %4d\n\n",player1->getXP());
                             DM->swapRenderMode();
                             break;
+                        case SDLK_m:
+                            DM->swapOverviewMode();
+                            break;
                     }
                     //printf("DEBUG: Board move direction (%2d).\n",boardDir); fflush(stdout);
                     break;
@@ -164,12 +281,15 @@ int main( int argc, char* args[] )
 
     DM->toPrint();
 
-    if (player1->getLP()<=0) {
-        printf("You died! ");
+    if (nullptr != player1)
+    {
+        if (player1->getLP()<=0) {
+            printf("You died! ");
+        }
+        printf("Remaining health = %4d\n\n",player1->getLP());
+        printf("Foes Vanquished  = %4d\n\n",player1->getKills());
+        printf("Total Experience = %4d\n\n",player1->getXP());
     }
-    printf("Remaining health = %4d\n\n",player1->getLP());
-    printf("Foes Vanquished  = %4d\n\n",player1->getKills());
-    printf("Total Experience = %4d\n\n",player1->getXP());
 
     //Free resources and close SDL
     //printf("DEBUG: Delete DM.\n");
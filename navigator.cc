@@ -23,12 +23,24 @@ bLoc operator+(const bLoc& lhs, const bLoc& rhs) {
 bLoc operator-(const bLoc& lhs, const bLoc& rhs) {
     return (bLoc){(lhs.x-rhs.x),(lhs.y-rhs.y)}; }
 
-// Comparison for std::priority_queue
+// Comparison for the unknown node heap (std::push_heap/pop_heap)
 struct CmpNodeDist {
-    bool operator()(const PNode* lhs, const PNode* rhs) const {
-        return lhs->getDist() > rhs->getDist(); }
+    bool operator()(const PNode& lhs, const PNode& rhs) const {
+        return lhs.getDist() > rhs.getDist(); }
 };
 
+// Reusable scratch storage for findPath. Grown to the largest board seen and
+// never shrunk, so repeated searches don't allocate (or clear) per call.
+//  nodeMark holds a per-search stamp: < stampBase is No Status,
+//  stampBase is Unknown and stampBase+1 is Known.
+struct PathScratch {
+    vector<unsigned int> nodeMark;
+    vector<bLoc>         prevLoc;   // previous node position for each location
+    vector<PNode>        uHeap;     // unknown/unvisited nodes (min-heap on distance)
+    unsigned int         stampBase = 0;
+};
+static thread_local PathScratch pathScratch;
+
 int REVERSE(int fwdDir)
 {
     switch(fwdDir) {
@@ -65,7 +77,9 @@ int REVERSE(int fwdDir)
     }
 };
 
-vector<bLoc> findPath(bLoc here, bLoc there, Gameboard* pBrd, double wtMult)
+// Dijkstra search shared by the Gameboard and BoardSnapshot versions
+template<class Board>
+static vector<bLoc> searchPath(bLoc here, bLoc there, Board* pBrd, double wtMult)
 {
     //printf("\n--------\nDEBUG: findPath BEGIN...\n"); fflush(stdout);
     vector<bLoc> pathLocs;   // vector of all locations along path
@@ -77,136 +91,122 @@ vector<bLoc> findPath(bLoc here, bLoc there, Gameboard* pBrd, double wtMult)
         pathLocs.push_back(here);
         return pathLocs; }
 
-    double distMax = 1.0*pBrd->getRows()*pBrd->getCols();
-    vector<PNode*> kNodes;     // known/visited nodes
-    std::priority_queue<PNode*, vector<PNode*>, CmpNodeDist> uNodes;    // unknown/unvisited nodes
+    const int nRows = pBrd->getRows();
+    const int nCols = pBrd->getCols();
+    double distMax = 1.0*nRows*nCols;
     bool pathFound = false;
 
-    // Create an array for the node status (No Status=0, Unknown=1, Known=2)
-    int nodeStat[pBrd->getRows()][pBrd->getCols()];
-    for (int jj=0; jj<pBrd->getRows(); jj++) {
-        for (int ii=0; ii<pBrd->getCols(); ii++) {
-            nodeStat[jj][ii] = 0;
-        }
+    // Prepare the scratch node status (No Status/Unknown/Known) for this search
+    PathScratch& scr = pathScratch;
+    if ((int)scr.nodeMark.size() < nRows*nCols) {
+        scr.nodeMark.resize(nRows*nCols);
+        scr.prevLoc.resize(nRows*nCols);
+    }
+    if (scr.stampBase >= 0xFFFFFFFDu) { // Stamps are about to wrap, start over
+        std::fill(scr.nodeMark.begin(), scr.nodeMark.end(), 0u);
+        scr.stampBase = 0;
     }
+    scr.stampBase += 2;
+    const unsigned int UNKNOWN = scr.stampBase;
+    const unsigned int KNOWN   = scr.stampBase+1;
+    vector<PNode>& uNodes = scr.uHeap;   // unknown/unvisited nodes
+    uNodes.clear();
 
     // Add the "here" location to the KNOWN nodes
-    kNodes.push_back(new PNode(here,here,0.0));
-    nodeStat[here.y][here.x] = 2;
+    PNode kNode(here,here,0.0);     // most recently visited node
+    scr.nodeMark[here.y*nCols+here.x] = KNOWN;
 
     // Check and set distances for all neighbors of the current node
     bLoc nebLoc;
-    vector<bLoc> deltaLocs   = { bLoc{-1,-1}, bLoc{ 0,-1}, bLoc{ 1,-1},
-                                 bLoc{-1, 0},              bLoc{ 1, 0},
-                                 bLoc{-1, 1}, bLoc{ 0, 1}, bLoc{ 1, 1} };
+    static const bLoc deltaLocs[8] = { bLoc{-1,-1}, bLoc{ 0,-1}, bLoc{ 1,-1},
+                                       bLoc{-1, 0},              bLoc{ 1, 0},
+                                       bLoc{-1, 1}, bLoc{ 0, 1}, bLoc{ 1, 1} };
 
     double dMult = 1.0;
     int    tElev = 0;
     double tDist = distMax;
-    for (vector<bLoc>::iterator iLoc=deltaLocs.begin(); iLoc!=deltaLocs.end(); iLoc++) {
-        nebLoc = kNodes.back()->nPos+(*iLoc);
-        //printf("DEBUG: findPath checking neighbor at [%2d,%2d]\n",nebLoc.x,nebLoc.y);
-
-        if ( (nebLoc.x >= 0) && (nebLoc.x < pBrd->getCols()) &&
-             (nebLoc.y >= 0) && (nebLoc.y < pBrd->getRows()) ) {
-            dMult = 1.0;
-            tElev = pBrd->getTile(nebLoc.y,nebLoc.x)->getElev();
-            if (tElev <= 1) {
-                dMult = pow(wtMult,0);
-            }
-            else {
-                dMult = pow(wtMult,(tElev-1));
-            }
-
-            tDist = distMax;
-            if ((0==(*iLoc).x)||(0==(*iLoc).y)) {   // N,E,S,W
-                tDist=1.0*dMult;
-            }
-            else {                                  // NE,SE,SW,NW
-                tDist=1.4*dMult;
-            }
-
-            if (!pBrd->getTile(nebLoc.y,nebLoc.x)->getOccupied() || dMult>1.01) {    // Avoid floating point equality comparison at 1.0
-                //printf("DEBUG: findPath UKNOWN node added at [%2d,%2d]\n",nebLoc.x,nebLoc.y);
-                uNodes.push(new PNode((bLoc){nebLoc.x,nebLoc.y},
-                                      kNodes.back()->nPos,
-                                      kNodes.back()->nDist+tDist));
-                                      //kNodes.back()->nDist+tDist+manhattan_dist(nebLoc,there)));
-                nodeStat[nebLoc.y][nebLoc.x] = 1;
-            }
-        }
-    }
 
     // Step through the nodes to find shortest path
     int    pathIter  = 0;
-    while ( (pathFound == false) && (uNodes.size()>0) && (pathIter<1000000) ) {
-        // Add the "visited" node to the KNOWN nodes
-        kNodes.push_back(uNodes.top());
-        nodeStat[uNodes.top()->nPos.y][uNodes.top()->nPos.x] = 2;
-
-        // Pop the "visited" node from the UNKNOWN nodes
-        uNodes.pop();
-
+    do {
         // Check if we've arrived at the destination
-        if (there==kNodes.back()->nPos) {
-            //printf("DEBUG: findPath found destination [%2d,%2d], d=%4.2f!\n",kNodes.back()->nPos.x,kNodes.back()->nPos.y,kNodes.back()->nDist); fflush(stdout);
+        if (there==kNode.nPos) {
+            //printf("DEBUG: findPath found destination [%2d,%2d], d=%4.2f!\n",kNode.nPos.x,kNode.nPos.y,kNode.nDist); fflush(stdout);
             pathFound = true;
+            break;
         }
-        else {  // Else, continue to check/add neighbors
-            for (vector<bLoc>::iterator iLoc=deltaLocs.begin(); iLoc!=deltaLocs.end(); iLoc++) {
-                nebLoc = kNodes.back()->nPos+(*iLoc);
-                //printf("DEBUG: findPath checking neighbor at [%2d,%2d]\n",nebLoc.x,nebLoc.y);
-
-                if ( (nebLoc.x >= 0) && (nebLoc.x < pBrd->getCols()) &&
-                     (nebLoc.y >= 0) && (nebLoc.y < pBrd->getRows()) ) {
-                    dMult = 1.0;
-                    tElev = pBrd->getTile(nebLoc.y,nebLoc.x)->getElev();
-                    if (tElev <= 1) {
-                        dMult = pow(wtMult,0);
-                    }
-                    else {
-                        dMult = pow(wtMult,(tElev-1));
-                    }
 
-                    tDist = distMax;
-                    if ((0==(*iLoc).x)||(0==(*iLoc).y)) {   // N,E,S,W
-                        tDist=1.0*dMult;
-                    }
-                    else {                                  // NE,SE,SW,NW
-                        tDist=1.4*dMult;
-                    }
+        // Else, continue to check/add neighbors. Blocked bits of the 3x3
+        // block around the node come from three bitboard reads, then drop
+        // the center bit so bit iLoc matches deltaLocs[iLoc].
+        unsigned int nbrBlk = 0;
+        for (int iR=0; iR<3; iR++) {
+            int bRow = kNode.nPos.y-1+iR;
+            if ((bRow >= 0) && (bRow < nRows)) {
+                uint64_t rBits = (kNode.nPos.x > 0) ? pBrd->getBlockedBits(bRow, kNode.nPos.x-1)
+                                                    : pBrd->getBlockedBits(bRow, 0) << 1;
+                nbrBlk |= (unsigned int)(rBits & 0x7) << (3*iR);
+            }
+        }
+        nbrBlk = (nbrBlk & 0x0F) | ((nbrBlk >> 1) & 0xF0);
+
+        for (int iLoc=0; iLoc<8; iLoc++) {
+            nebLoc = kNode.nPos+deltaLocs[iLoc];
+            //printf("DEBUG: findPath checking neighbor at [%2d,%2d]\n",nebLoc.x,nebLoc.y);
+
+            if ( (nebLoc.x >= 0) && (nebLoc.x < nCols) &&
+                 (nebLoc.y >= 0) && (nebLoc.y < nRows) ) {
+                dMult = 1.0;
+                tElev = pBrd->getTile(nebLoc.y,nebLoc.x).getElev();
+                if (tElev <= 1) {
+                    dMult = pow(wtMult,0);
+                }
+                else {
+                    dMult = pow(wtMult,(tElev-1));
+                }
+
+                tDist = distMax;
+                if ((0==deltaLocs[iLoc].x)||(0==deltaLocs[iLoc].y)) {   // N,E,S,W
+                    tDist=1.0*dMult;
+                }
+                else {                                                  // NE,SE,SW,NW
+                    tDist=1.4*dMult;
+                }
 
-                    if (!pBrd->getTile(nebLoc.y,nebLoc.x)->getOccupied() || dMult>1.01) {   // Avoid floating point equality comparison at 1.0
-                        if (0==nodeStat[nebLoc.y][nebLoc.x]) {
-                            //printf("DEBUG: findPath UKNOWN node added at [%2d,%2d]\n",nebLoc.x,nebLoc.y);
-                            uNodes.push(new PNode((bLoc){nebLoc.x,nebLoc.y},
-                                                  kNodes.back()->nPos,
-                                                  kNodes.back()->nDist+tDist));
-                                                  //kNodes.back()->nDist+tDist+manhattan_dist(nebLoc,there)));
-                            nodeStat[nebLoc.y][nebLoc.x] = 1;
-                        }
+                if (!(nbrBlk & (1u<<iLoc)) || dMult>1.01) {   // Avoid floating point equality comparison at 1.0
+                    if (scr.nodeMark[nebLoc.y*nCols+nebLoc.x] < UNKNOWN) {
+                        //printf("DEBUG: findPath UKNOWN node added at [%2d,%2d]\n",nebLoc.x,nebLoc.y);
+                        uNodes.push_back(PNode(nebLoc, kNode.nPos, kNode.nDist+tDist));
+                                              //kNode.nDist+tDist+manhattan_dist(nebLoc,there)));
+                        std::push_heap(uNodes.begin(), uNodes.end(), CmpNodeDist());
+                        scr.nodeMark[nebLoc.y*nCols+nebLoc.x] = UNKNOWN;
+                        scr.prevLoc[nebLoc.y*nCols+nebLoc.x]  = kNode.nPos;
                     }
                 }
             }
         }
 
-        pathIter++;
-    }
+        if (uNodes.empty()) {
+            break;
+        }
+
+        // Add the "visited" node to the KNOWN nodes and pop it from the UNKNOWN nodes
+        std::pop_heap(uNodes.begin(), uNodes.end(), CmpNodeDist());
+        kNode = uNodes.back();
+        uNodes.pop_back();
+        scr.nodeMark[kNode.nPos.y*nCols+kNode.nPos.x] = KNOWN;
+    } while (pathIter++ < 1000000);
     //printf("DEBUG: pathFind iterations = %4d\n",pathIter); fflush(stdout);
 
     if (pathFound) {
-        //printf("DEBUG: pathFind destination distance = %f\n", kNodes.back()->nDist); fflush(stdout);
+        //printf("DEBUG: pathFind destination distance = %f\n", kNode.nDist); fflush(stdout);
 
-        // Build pathLocs vector here...
+        // Build pathLocs vector by walking back from the destination
         bLoc pLoc = there;
         while  (pLoc != here) {
-            for (vector<PNode*>::iterator iNode=kNodes.begin();iNode!=kNodes.end();iNode++) {
-                if ( (*iNode)->nPos == pLoc ){
-                    //printf("DEBUG: pathFind pLoc = [%2d,%2d]\n",pLoc.x,pLoc.y); fflush(stdout);
-                    pathLocs.push_back((*iNode)->nPos);
-                    pLoc = (*iNode)->pPos;
-                }
-            }
+            //printf("DEBUG: pathFind pLoc = [%2d,%2d]\n",pLoc.x,pLoc.y); fflush(stdout);
+            pathLocs.push_back(pLoc);
+            pLoc = scr.prevLoc[pLoc.y*nCols+pLoc.x];
         }
     }
     else {
@@ -216,6 +216,16 @@ vector<bLoc> findPath(bLoc here, bLoc there, Gameboard* pBrd, double wtMult)
     return pathLocs;
 };
 
+vector<bLoc> findPath(bLoc here, bLoc there, Gameboard* pBrd, double wtMult)
+{
+    return searchPath(here, there, pBrd, wtMult);
+}
+
+vector<bLoc> findPath(bLoc here, bLoc there, BoardSnapshot* pBrd, double wtMult)
+{
+    return searchPath(here, there, pBrd, wtMult);
+}
+
 PNode::PNode(bLoc loc, bLoc prev, double dist)
 {
     nPos  = loc;
@@ -14,6 +14,7 @@
 using namespace std;
 
 class Gameboard;
+class BoardSnapshot;
 
 enum DIRECTION {
     SW     = 1,
@@ -43,6 +44,9 @@ int REVERSE(int);
 
 vector<bLoc> findPath(bLoc here, bLoc there, Gameboard* pBrd, double wtMult=1.0);
 
+// Same search over a snapshot (safe from any thread)
+vector<bLoc> findPath(bLoc here, bLoc there, BoardSnapshot* pBrd, double wtMult=1.0);
+
 // == operator overload for bLoc
 bool operator==(const bLoc& lhs, const bLoc& rhs);
 
@@ -0,0 +1,421 @@
+/*
+ *  NPC Store
+ */
+
+#include <algorithm>
+
+#include "npc.hh"
+#include "gameboard.hh"
+#include "pawn.hh"
+#include "workerpool.hh"
+
+int aiBudget = 64;
+
+int NPCStore::add(int x, int y, unsigned char npcT, bool isHstl, double moveP)
+{
+    int iN = size();
+    pos.push_back(bLoc{x,y});
+    lp.push_back(1);
+    xp.push_back(5);
+    kills.push_back(0);
+    type.push_back(npcT);
+    hostile.push_back(isHstl ? 1 : 0);
+    look.push_back(0);
+    moveProb.push_back(moveP);
+    path.push_back(-1);
+    cellNext.push_back(-1);
+    actvIdx.push_back(-1);
+    waiting.push_back(0);
+
+    uint32_t id = idSlot.size();
+    if (!idFree.empty()) {
+        id = idFree.back();
+        idFree.pop_back(); }
+    else {
+        idSlot.push_back(-1);
+        idGen.push_back(0); }
+    idSlot[id] = iN;
+    handle.push_back(((NPCHandle)idGen[id]<<idBits) | id);
+
+    if (0 == gridCols) {
+        gridRows = (mBoard->getRows()+gridSize-1)>>gridBits;
+        gridCols = (mBoard->getCols()+gridSize-1)>>gridBits;
+        cellHead.assign(gridRows*gridCols, -1); }
+    gridAdd(iN);
+
+    return iN;
+}
+
+void NPCStore::remove(int iN)
+{
+    if (path[iN] >= 0) {
+        pathPool[path[iN]].clear();
+        pathFree.push_back(path[iN]); }
+    if (actvIdx[iN] >= 0) {
+        deactivate(iN); }
+    if (lp[iN] > 0) {   // killed NPCs already left their tile and the grid
+        mBoard->getTile(pos[iN].y,pos[iN].x).rmvOccupant();
+        gridRmv(iN); }
+
+    // Retire the handle (the generation wraps after 2^32 reuses of an id)
+    uint32_t id = handle[iN] & idMask;
+    idSlot[id] = -1;
+    idGen[id]  = idGen[id]+1;
+    idFree.push_back(id);
+
+    // Move the last NPC into the hole
+    int lN = size()-1;
+    if (iN != lN)
+    {
+        if (lp[lN] > 0) {
+            gridRmv(lN); }
+
+        pos[iN]      = pos[lN];
+        lp[iN]       = lp[lN];
+        xp[iN]       = xp[lN];
+        kills[iN]    = kills[lN];
+        type[iN]     = type[lN];
+        hostile[iN]  = hostile[lN];
+        look[iN]     = look[lN];
+        moveProb[iN] = moveProb[lN];
+        path[iN]     = path[lN];
+        actvIdx[iN]  = actvIdx[lN];
+        handle[iN]   = handle[lN];
+        waiting[iN]  = waiting[lN];
+
+        idSlot[handle[iN] & idMask] = iN;
+        if (actvIdx[iN] >= 0) {
+            actv[actvIdx[iN]] = iN; }
+        if (lp[iN] > 0) {
+            gridAdd(iN);
+            mBoard->getTile(pos[iN].y,pos[iN].x).setNPC(iN); }
+    }
+
+    pos.pop_back();
+    lp.pop_back();
+    xp.pop_back();
+    kills.pop_back();
+    type.pop_back();
+    hostile.pop_back();
+    look.pop_back();
+    moveProb.pop_back();
+    path.pop_back();
+    cellNext.pop_back();
+    actvIdx.pop_back();
+    handle.pop_back();
+    waiting.pop_back();
+}
+
+int NPCStore::reap()
+{
+    // Handles stay valid as other removals move NPCs around
+    int numDead = 0;
+    for (NPCHandle hNPC : dead)
+    {
+        int iN = slotOf(hNPC);
+        if (iN >= 0) {
+            //printf("DEBUG: NPCStore::reap removing pawn %1c from board\n",type[iN]); fflush(stdout);
+            remove(iN);
+            numDead++; }
+    }
+    dead.clear();
+    return numDead;
+}
+
+void NPCStore::activate(int iN)
+{
+    actvIdx[iN] = actv.size();
+    actv.push_back(iN);
+}
+
+void NPCStore::deactivate(int iN)
+{
+    // Swap the last active NPC into its place
+    int iA = actvIdx[iN];
+    actv[iA] = actv.back();
+    actvIdx[actv[iA]] = iA;
+    actv.pop_back();
+    actvIdx[iN] = -1;
+}
+
+void NPCStore::gridAdd(int iN)
+{
+    int iC = cellOf(pos[iN]);
+    cellNext[iN] = cellHead[iC];
+    cellHead[iC] = iN;
+}
+
+void NPCStore::gridRmv(int iN)
+{
+    int32_t* iL = &cellHead[cellOf(pos[iN])];
+    while (*iL != iN) {
+        iL = &cellNext[*iL]; }
+    *iL = cellNext[iN];
+}
+
+void NPCStore::inRect(int row0, int col0, int rows, int cols, vector<int>& found)
+{
+    found.clear();
+    int row1 = std::min(row0+rows, gridRows*gridSize);
+    int col1 = std::min(col0+cols, gridCols*gridSize);
+    row0 = std::max(row0, 0);
+    col0 = std::max(col0, 0);
+    if ((row0 >= row1) || (col0 >= col1)) {
+        return; }
+
+    for (int gy=row0>>gridBits; gy<=((row1-1)>>gridBits); gy++)
+    {
+        for (int gx=col0>>gridBits; gx<=((col1-1)>>gridBits); gx++)
+        {
+            for (int iN=cellHead[gy*gridCols+gx]; iN>=0; iN=cellNext[iN])
+            {
+                if ((pos[iN].y >= row0) && (pos[iN].y < row1) && (pos[iN].x >= col0) && (pos[iN].x < col1)) {
+                    found.push_back(iN); }
+            }
+        }
+    }
+}
+
+void NPCStore::inRadius(bLoc loc, int rad, vector<int>& found)
+{
+    inRect(loc.y-rad+1, loc.x-rad+1, 2*rad-1, 2*rad-1, found);
+
+    found.erase(std::remove_if(found.begin(), found.end(), [&](int iN) {
+                    bLoc dLoc = pos[iN]-loc;
+                    return (dLoc.x*dLoc.x + dLoc.y*dLoc.y) >= rad*rad; }),
+                found.end());
+}
+
+void NPCStore::nearest(bLoc loc, int kk, int rad, vector<int>& found)
+{
+    found.clear();
+    if ((kk <= 0) || (0 == gridCols)) {
+        return; }
+
+    // Search rings of cells outward from loc's cell until no unvisited cell
+    // can hold anything nearer than the kk-th candidate
+    vector<std::pair<int,int>> cands;   // {squared distance, slot}
+    int gX = std::min(std::max(loc.x>>gridBits, 0), gridCols-1);
+    int gY = std::min(std::max(loc.y>>gridBits, 0), gridRows-1);
+    int maxRing = std::max(std::max(gX, gridCols-1-gX), std::max(gY, gridRows-1-gY));
+    for (int ring=0; ring<=maxRing; ring++)
+    {
+        // Closest any tile in this ring can be
+        int minDist = std::max(0, (ring-1)*gridSize+1);
+        if (minDist >= rad) {
+            break; }
+        if ((int)cands.size() >= kk)
+        {
+            std::nth_element(cands.begin(), cands.begin()+kk-1, cands.end());
+            if (cands[kk-1].first < minDist*minDist) {
+                break; }
+        }
+
+        for (int gy=std::max(0,gY-ring); gy<=std::min(gridRows-1,gY+ring); gy++)
+        {
+            // Only the ring's edge cells on rows strictly inside it
+            int step = ((gy == gY-ring) || (gy == gY+ring)) ? 1 : 2*ring;
+            for (int gx=gX-ring; gx<=gX+ring; gx+=step)
+            {
+                if ((gx < 0) || (gx >= gridCols)) {
+                    continue; }
+
+                for (int iN=cellHead[gy*gridCols+gx]; iN>=0; iN=cellNext[iN])
+                {
+                    bLoc dLoc  = pos[iN]-loc;
+                    int  dist2 = dLoc.x*dLoc.x + dLoc.y*dLoc.y;
+                    if (dist2 < rad*rad) {
+                        cands.push_back(std::make_pair(dist2, iN)); }
+                }
+            }
+        }
+    }
+
+    std::sort(cands.begin(), cands.end());
+    for (int iC=0; iC<std::min(kk,(int)cands.size()); iC++) {
+        found.push_back(cands[iC].second); }
+}
+
+vector<bLoc>& NPCStore::getPath(int iN)
+{
+    if (path[iN] < 0)
+    {
+        if (pathFree.empty()) {
+            path[iN] = pathPool.size();
+            pathPool.push_back(vector<bLoc>()); }
+        else {
+            path[iN] = pathFree.back();
+            pathFree.pop_back(); }
+    }
+    return pathPool[path[iN]];
+}
+
+DIRECTION NPCStore::moveTo(int iN, bLoc toPos, bool dmgMove)
+{
+    if (pos[iN] == toPos) {
+        return CENTER;
+    }
+
+    // TODO: Evaluate if non-hostile NPCs should deal damage
+    Tile toTile = mBoard->getTile(toPos.y,toPos.x);
+    if (dmgMove && toTile.hasOccupant()) {
+        printf("INFO: NPCStore::moveTo  %1c dealing damage\n",type[iN]); fflush(stdout);
+        int victim   = toTile.getNPC();
+        int xpGained = (victim >= 0) ? takeDmg(victim,1) : toTile.getPawn()->takeDmg(1);
+        xp[iN] += xpGained;
+        if (xpGained>0) {
+            kills[iN]++;
+        }
+        return CENTER;
+    }
+    else if (!toTile.getOccupied())
+    {
+        mBoard->getTile(pos[iN].y,pos[iN].x).rmvOccupant();
+        bool newCell = (cellOf(toPos) != cellOf(pos[iN]));
+        if (newCell) {
+            gridRmv(iN); }
+        pos[iN] = toPos;
+        if (newCell) {
+            gridAdd(iN); }
+        toTile.setNPC(iN);
+        return CENTER;
+    }
+    else {
+        return NODIR;
+    }
+}
+
+int NPCStore::takeDmg(int iN, int dmg)
+{
+    lp[iN] = lp[iN]-dmg;   // NPCs are always vulnerable
+
+    if ((lp[iN]<=0) && (lp[iN]+dmg > 0)) {
+        printf("INFO: NPCStore::takeDmg %1c killed. Returning XP = %3d\n",type[iN],xp[iN]); fflush(stdout);
+
+        // Free its tile now, the slot goes at the next reap
+        mBoard->getTile(pos[iN].y,pos[iN].x).rmvOccupant();
+        gridRmv(iN);
+        dead.push_back(handle[iN]);
+        return xp[iN];
+    }
+    return 0;
+}
+
+void NPCStore::takeTurn(bLoc playerPos)
+{
+    turn++;
+    if (actv.empty()) {
+        return; }
+
+    // Paths are created up front so planning never grows the pool
+    for (int iN : actv) {
+        getPath(iN); }
+
+    // Priority for path searches: denied last turn, hostile, then nearest
+    order.assign(actv.begin(), actv.end());
+    std::sort(order.begin(), order.end(), [&](int lN, int rN) {
+        if (waiting[lN] != waiting[rN]) {
+            return (waiting[lN] > waiting[rN]); }
+        if (hostile[lN] != hostile[rN]) {
+            return (hostile[lN] > hostile[rN]); }
+        bLoc lLoc = pos[lN]-playerPos;
+        bLoc rLoc = pos[rN]-playerPos;
+        int  lDist2 = lLoc.x*lLoc.x + lLoc.y*lLoc.y;
+        int  rDist2 = rLoc.x*rLoc.x + rLoc.y*rLoc.y;
+        if (lDist2 != rDist2) {
+            return (lDist2 < rDist2); }
+        return (handle[lN] < handle[rN]); });
+
+    // Grant the searches in priority order, counting only NPCs that will
+    // search: those that act this turn and are hostile or out of path. The
+    // rolls come from each NPC's turn stream, so plan() repeats them, and
+    // the turn replays the same on any machine.
+    granted.assign(order.size(), 0);
+    int numGranted = 0;
+    for (size_t iO=0; (iO<order.size()) && ((aiBudget <= 0) || (numGranted < aiBudget)); iO++)
+    {
+        int iN = order[iO];
+        std::mt19937 rng = turnRng(iN);
+        if (rollsMove(iN, rng) && (hostile[iN] || pathPool[path[iN]].empty())) {
+            granted[iO] = 1;
+            numGranted++; }
+    }
+
+    plans.resize(order.size());
+    {
+        BoardSnapshot snap = mBoard->snapshot();
+        parallelFor(order.size(), planBatch, [&](int lo, int hi) {
+            for (int iO=lo; iO<hi; iO++) {
+                plans[iO] = plan(order[iO], playerPos, snap, (0 != granted[iO])); }
+        });
+    }   // Drop the snapshot before resolving so writes don't copy chunks
+
+    // Same order whatever the thread count or activation history
+    std::sort(plans.begin(), plans.end(), [](const NPCPlan& lhs, const NPCPlan& rhs) {
+        return lhs.hNPC < rhs.hNPC; });
+    for (const NPCPlan& pln : plans) {
+        resolve(pln); }
+}
+
+std::mt19937 NPCStore::turnRng(int iN)
+{
+    // Each NPC draws from its own stream for the turn, so its plan doesn't
+    // depend on which thread makes it or when
+    return std::mt19937(deriveSeed(SEED_AI, (int)(handle[iN] ^ (handle[iN]>>idBits)), turn));
+}
+
+bool NPCStore::rollsMove(int iN, std::mt19937& rng)
+{
+    return (lp[iN] > 0) && (randI(rng,0,999) < (moveProb[iN]*1000));
+}
+
+NPCPlan NPCStore::plan(int iN, bLoc playerPos, BoardSnapshot& snap, bool canSearch)
+{
+    NPCPlan pln = { handle[iN], pos[iN], ACT_NONE };
+
+    std::mt19937 rng = turnRng(iN);
+    if (!rollsMove(iN, rng)) {
+        return pln; }
+
+    vector<bLoc>& myPath = pathPool[path[iN]];
+
+    // Out of budget: keep following the current path, if any
+    waiting[iN] = (!canSearch && (hostile[iN] || myPath.empty())) ? 1 : 0;
+    if (canSearch && hostile[iN])
+    {
+        myPath = findPath(pos[iN],playerPos,&snap);    // Try to find a path to the player
+    }
+
+    if (canSearch && myPath.empty())
+    {
+        // Pick a random location on the map and wander to it
+        myPath = findPath(pos[iN],
+                          bLoc{randI(rng,0,snap.getCols()-1),randI(rng,0,snap.getRows()-1)},
+                          &snap);
+    }
+
+    if (!myPath.empty())
+    {
+        pln.toPos = myPath.back();
+        pln.act   = snap.getTile(pln.toPos.y,pln.toPos.x).hasOccupant() ? ACT_ATTACK : ACT_MOVE;
+    }
+    return pln;
+}
+
+void NPCStore::resolve(const NPCPlan& pln)
+{
+    int iN = slotOf(pln.hNPC);
+    if ((iN < 0) || (ACT_NONE == pln.act) || (lp[iN] <= 0)) {   // killed earlier in the turn
+        return; }
+
+    vector<bLoc>& myPath = pathPool[path[iN]];
+    int toDir = moveTo(iN, pln.toPos, (ACT_ATTACK == pln.act));
+    if (NODIR==toDir) {
+        myPath.clear(); // bumbed into something, stop moving
+    }
+    else {
+        myPath.pop_back();
+    }
+}
+
+// EOF
@@ -0,0 +1,185 @@
+/*
+ *  NPC Store
+ *
+ *  Every NPC on a board lives in the board's NPCStore as one slot of a set
+ *  of component arrays (structure of arrays), so a turn walks contiguous
+ *  arrays instead of chasing a heap object per NPC. An NPC is its slot
+ *  index; Tile occupants refer to NPCs by slot (see Tile::getNPC).
+ *
+ *  Slots move when NPCs are removed (the last NPC is swapped into the hole),
+ *  so anything holding on to an NPC across turns keeps its handle instead:
+ *  a slot id plus a generation, which goes stale once the NPC is removed.
+ *
+ *  An NPC killed during a turn leaves its tile and the grid at once, but
+ *  keeps its slot until reap() at the start of the next turn.
+ *
+ *  NPCs are also bucketed in a uniform grid of gridSize x gridSize cells
+ *  (a linked list per cell), so proximity queries only visit the cells
+ *  they overlap and cost scales with the local population.
+ *
+ *  Only active NPCs take turns. They are listed in actv (in no order);
+ *  dormant NPCs are only found through the grid, when the player comes near.
+ *
+ *  A turn has two phases. Every active NPC first plans its action against
+ *  a snapshot of the board, reading nothing else that changes, so the plans
+ *  run in parallel. The plans are then applied one by one in handle order,
+ *  and the first NPC to reach a tile gets it.
+ *
+ *  Path searches are the expensive part of planning, so only aiBudget NPCs
+ *  may search per turn. Searches are granted before planning, in priority
+ *  order (those denied a search last turn, then hostile ones, then the
+ *  nearest to the player), to NPCs that act this turn and need a path. The
+ *  rest keep following the paths they have.
+ */
+
+#ifndef __NPC_HH__
+#define __NPC_HH__
+
+#include <vector>
+#include <cstdint>
+#include <random>
+
+#include "navigator.hh"
+
+using namespace std;
+
+class Gameboard;
+class BoardSnapshot;
+
+// NPCs that may run path searches per turn (0 for no limit)
+extern int aiBudget;
+
+// NPC handle: generation in the high bits, id in the low idBits
+typedef uint64_t NPCHandle;
+
+// What an NPC does this turn (see NPCStore::plan)
+enum NPC_ACT {
+    ACT_NONE   = 0,
+    ACT_MOVE   = 1,     // Step onto a tile that was free
+    ACT_ATTACK = 2 };   // Step onto a tile that was occupied (damaging the occupant)
+
+struct NPCPlan {
+    NPCHandle hNPC;
+    bLoc      toPos;
+    NPC_ACT   act;
+};
+
+struct NPCStore
+{
+    // Board the NPCs are on
+    Gameboard* mBoard;
+
+    // Components, one entry per NPC
+    vector<bLoc>          pos;          // Board location
+    vector<int>           lp;           // Life Points
+    vector<int>           xp;           // Experience Points (awarded to whoever kills it)
+    vector<int>           kills;
+    vector<unsigned char> type;         // Pawn type (see Pawn::getType)
+    vector<unsigned char> hostile;      // Paths toward the player
+    vector<unsigned char> look;         // Texture variant (set by the renderer)
+    vector<double>        moveProb;     // Probability to move each turn
+    vector<int32_t>       path;         // Queued path (handle into pathPool), -1 if none
+    vector<int32_t>       cellNext;     // Next NPC in the same grid cell, -1 if last
+    vector<int32_t>       actvIdx;      // Position in actv, -1 if dormant
+    vector<NPCHandle>     handle;
+    vector<unsigned char> waiting;      // Was denied a path search last turn
+
+    // Queued paths, pooled so NPCs that never move hold none
+    vector<vector<bLoc>> pathPool;
+    vector<int32_t>      pathFree;
+
+    // Handle ids: slot and generation of each id, unused ids. There are never
+    // more ids than tiles (at most 8192 x 8192), so ids can't reach the
+    // generation bits.
+    static const int      idBits = 32;
+    static const uint64_t idMask = (1ULL<<idBits)-1;
+    vector<int32_t>  idSlot;            // -1 if the id is unused
+    vector<uint32_t> idGen;
+    vector<uint32_t> idFree;
+
+    // NPCs killed this turn, removed by reap()
+    vector<NPCHandle> dead;
+
+    // Active NPCs
+    vector<int32_t> actv;
+    int             actvCell;           // Grid cell activation last ran from, -1 if never
+
+    // Turn plans (one per active NPC) in priority order, turns taken
+    static const int planBatch = 16;    // Plans per worker task
+    vector<int32_t> order;
+    vector<unsigned char> granted;      // Per entry of order: may search this turn
+    vector<NPCPlan> plans;
+    int             turn;
+
+    // Spatial grid (sized from the board on the first add)
+    static const int gridBits = 3;
+    static const int gridSize = 1<<gridBits;
+    int gridRows;
+    int gridCols;
+    vector<int32_t> cellHead;           // First NPC in each cell, -1 if empty
+
+    NPCStore( Gameboard* inBoard ) : mBoard(inBoard), actvCell(-1), turn(0), gridRows(0), gridCols(0) {};
+
+    int  size() { return pos.size(); };
+
+    // Slot of a handle, -1 once that NPC is removed
+    int  slotOf(NPCHandle hNPC) {
+        uint64_t id = hNPC & idMask;
+        return ((id < idSlot.size()) && (idGen[id] == (hNPC>>idBits))) ? idSlot[id] : -1; };
+    int  cellOf(bLoc loc) { return (loc.y>>gridBits)*gridCols + (loc.x>>gridBits); };
+
+    // Move an NPC into/out of the active set
+    void activate(int iN);
+    void deactivate(int iN);
+
+    // Link/unlink an NPC in the cell of its current position
+    void gridAdd(int iN);
+    void gridRmv(int iN);
+
+    // NPCs with a position inside the rectangle (any order)
+    void inRect(int row0, int col0, int rows, int cols, vector<int>& found);
+
+    // NPCs closer than rad tiles to loc (any order)
+    void inRadius(bLoc loc, int rad, vector<int>& found);
+
+    // Up to kk NPCs closer than rad tiles to loc, nearest first (ties by slot)
+    void nearest(bLoc loc, int kk, int rad, vector<int>& found);
+
+    // Add an NPC (the caller places it on its tile), returns its slot
+    int  add(int x, int y, unsigned char npcT, bool isHstl, double moveP);
+
+    // Remove an NPC from the board, the last NPC moves into its slot
+    void remove(int iN);
+
+    // Remove the NPCs killed since the last reap, returns how many
+    int  reap();
+
+    // Queued path of an NPC (created on first use)
+    vector<bLoc>& getPath(int iN);
+
+    // Move an NPC (attacking an occupant if dmgMove), same results as Pawn::moveTo
+    DIRECTION moveTo(int iN, bLoc toPos, bool dmgMove=true);
+
+    // Damage an NPC, returns its XP if this killed it (then queued for reap)
+    int  takeDmg(int iN, int dmg);
+
+    // Take a turn for every active NPC: plan in parallel, then resolve
+    void takeTurn(bLoc playerPos);
+
+    // An NPC's random stream for this turn, and its roll to act this turn
+    // (the first draw from that stream)
+    std::mt19937 turnRng(int iN);
+    bool rollsMove(int iN, std::mt19937& rng);
+
+    // "Do your thing": decide what an NPC does this turn without changing
+    // the board, searching for a new path only if canSearch. Safe to call
+    // for different NPCs at once (the NPC's path must already exist, see
+    // getPath).
+    NPCPlan plan(int iN, bLoc playerPos, BoardSnapshot& snap, bool canSearch);
+
+    // Apply a plan. A move onto a tile taken earlier in the turn is a bump.
+    void resolve(const NPCPlan& pln);
+};
+
+#endif
+// EOF
@@ -4,16 +4,31 @@
 
 #include "pawn.hh"
 
+// Pawn index slots (nullptr when free) and the free slots
+static vector<Pawn*> pawnIndex;
+static vector<int>   pawnFree;
+
+Pawn* Pawn::fromIdx(int inIdx)
+{
+    return (inIdx >= 0) ? pawnIndex[inIdx] : nullptr;
+}
+
 Pawn::Pawn( Gameboard* inBoard, int initX, int initY )
 {
+    if (pawnFree.empty()) {
+        pIdx = pawnIndex.size();
+        pawnIndex.push_back(this); }
+    else {
+        pIdx = pawnFree.back();
+        pawnFree.pop_back();
+        pawnIndex[pIdx] = this; }
+
     //Initialize
     isPlayer  = false;
-    isActive  = false;
     pawnType  = '@';
     pawnTexture = nullptr;
 
     mPos    = bLoc{initX,initY};
-    prevPos = bLoc{initX,initY};
 
     vulnerable = true;
     lp = 1;
@@ -26,7 +41,8 @@ Pawn::Pawn( Gameboard* inBoard, int initX, int initY )
 
 Pawn::~Pawn()
 {
-    // Nothing to do for now...
+    pawnIndex[pIdx] = nullptr;
+    pawnFree.push_back(pIdx);
 }
 
 void Pawn::setPlayer()
@@ -118,21 +134,20 @@ DIRECTION Pawn::moveTo( int toX, int toY, bool dmgMove)
     }
 
     // TODO: Evaluate if non-hostile NPCs should deal damage
-    if (dmgMove && mBoard->getTile(toY,toX)->hasPawn()) {
+    if (dmgMove && mBoard->getTile(toY,toX).hasOccupant()) {
         printf("INFO: Pawn::moveTo  %1c dealing damage\n",pawnType); fflush(stdout);
         addXP(dealDmg(mBoard->getTile(toY,toX),1));
         return CENTER;
     }
-    else if (!mBoard->getTile(toY,toX)->getOccupied())
+    else if (!mBoard->getTile(toY,toX).getOccupied())
     {
-        prevPos = mPos;
-        mBoard->getTile(prevPos.y,prevPos.x)->rmvPawn();
+        mBoard->getTile(mPos.y,mPos.x).rmvOccupant();
 
         mPos.x = toX;
         mPos.y = toY;
 
         // Update tile occupation if not moving to new board
-        mBoard->getTile(mPos.y,mPos.x)->setPawn(this);
+        mBoard->getTile(mPos.y,mPos.x).setPawn(this);
 
         //if (isPlayer)
         //{
@@ -147,36 +162,17 @@ DIRECTION Pawn::moveTo( int toX, int toY, bool dmgMove)
     }
 }
 
-void Pawn::moveBack()
-{
-    //printf("DEBUG: Pawn::moveBack Prev Pos = [%2d,%2d]\n",prevPos.x,prevPos.y); fflush(stdout);
-    mPos = prevPos;
-}
-
 void Pawn::setBoard( Gameboard* inBoard )
 {
     mBoard = inBoard;
-    mBoard->getTile(mPos.y,mPos.x)->setPawn(this);
-}
-
-void Pawn::setVulnerable( bool isVuln)
-{
-    vulnerable = isVuln;
+    mBoard->getTile(mPos.y,mPos.x).setPawn(this);
 }
 
-
-
 void Pawn::setLP(int inLP)
 {
     lp = inLP;
 }
 
-bool Pawn::setActive(bool inAct)
-{
-    isActive = inAct;
-    return isActive;
-}
-
 int Pawn::addXP(int newXP)
 {
     //printf("DEBUG: Pawn::addXP adding XP = %3d\n",newXP); fflush(stdout);
@@ -184,9 +180,11 @@ int Pawn::addXP(int newXP)
     return xp;
 }
 
-int Pawn::dealDmg(Tile* dltTile, signed int dltDmg)
+int Pawn::dealDmg(Tile dltTile, signed int dltDmg)
 {
-    int xpGained = dltTile->getPawn()->takeDmg(dltDmg);
+    int victim   = dltTile.getNPC();
+    int xpGained = (victim >= 0) ? mBoard->getNPCs()->takeDmg(victim,dltDmg)
+                                 : dltTile.getPawn()->takeDmg(dltDmg);
     if (xpGained>0) {
         // TODO: Evaluate when kills should be awarded (non-hostile, immobile, etc.)
         kills=kills+1;
@@ -208,7 +206,6 @@ int Pawn::takeDmg(signed int tknDmg)
 
     if (lp<=0) {
         printf("INFO: Pawn::takeDmg %1c killed. Returning XP = %3d\n",pawnType,xp); fflush(stdout);
-        mBoard->checkNPCs(mPos);
         // TODO: Evaluate when xp should be awarded (non-hostile, immobile, etc.)
         return xp;
     }
@@ -217,57 +214,4 @@ int Pawn::takeDmg(signed int tknDmg)
     }
 }
 
-NPC::NPC( Gameboard* inBoard, int initX, int initY, unsigned char npcT, bool isHstl, double moveP )
-    : Pawn(inBoard, initX, initY)
-{
-    //Initialize
-    pawnType   = npcT;
-    isHostile = isHstl;
-    moveProb  = moveP;
-    addXP(5);
-}
-
-void NPC::setMoveProb(double inProb)
-{
-    moveProb = inProb;
-}
-
-double NPC::getMoveProb()
-{
-    return moveProb;
-}
-
-void NPC::dyt(bLoc inputPos)
-{
-    if (isActive)
-    {
-        if (randI1000()<(moveProb*1000))
-        {
-            if (isHostile)
-            {
-                myPath = findPath(getPos(),inputPos,mBoard);    // Try to find a path to the player
-            }
-
-            if (myPath.empty())
-            {
-                // Pick a random location on the map and wander to it
-                myPath = findPath(getPos(),
-                                  bLoc{randI(0,mBoard->getCols()-1),randI(0,mBoard->getRows()-1)},
-                                  mBoard);
-            }
-
-            if (!myPath.empty())
-            {
-                int toDir = moveTo(myPath.back());
-                if (NODIR==toDir) {
-                    myPath.clear(); // bumbed into something, stop moving
-                }
-                else {
-                    myPath.pop_back();
-                }
-            }
-        }
-    }
-}
-
 // EOF
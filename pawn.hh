@@ -30,21 +30,17 @@ private:
 
     // Pawn Location
     bLoc mPos;
-    bLoc prevPos;
 //    bLoc fovPos;
 
     SDL_Texture* pawnTexture;
 
+    // Slot in the pawn index (Tile occupants refer to Pawns by index)
+    int pIdx;
+
 protected:
     // Board info for player
     Gameboard* mBoard;
 
-    // Does this pawn do anything?
-    bool isActive;
-
-    // Queued Path
-    vector<bLoc> myPath;
-
     // ID for Pawn type      TODO: Evaluate the best way to track NPC types (i.e. cactus, cow, bandit, etc);
     unsigned char pawnType;
 
@@ -68,13 +64,10 @@ public:
     DIRECTION moveDir(int);
     DIRECTION moveTo(bLoc);
     DIRECTION moveTo(int toX, int toY, bool dmgMove=true);
-    void      moveBack();
     void      setLP(int);
-    bool      setActive(bool inAct=true);
     int       addXP(int);
-    int       dealDmg(Tile*, int);
+    int       dealDmg(Tile, int);
     int       takeDmg(int);
-    void      setVulnerable(bool);
     void      setTexture(SDL_Texture*);
 
     // Accessors
@@ -89,34 +82,15 @@ public:
     bool        isVulnerable()          { return vulnerable; };
     signed int  getLP()                 { return lp; };
     int         getXP()                 { return xp; };
-    bool        getActive()             { return isActive; };
     int         getKills()              { return kills; };
     SDL_Texture* getTexture()           { return pawnTexture; };
 
     // Return Pawn type (for rendering, etc.)
     unsigned char getType() { return pawnType; };
-};
-
-class NPC : public Pawn
-{
-private:
-    // Is this NPC hostile?
-    bool isHostile;
-
-    // Probability for  NPC to move
-    double moveProb;
-
-public:
-    // Constructor & Destructor
-    NPC(Gameboard* inBoard, int initX, int initY, unsigned char npcT='c', bool isHstl=false, double moveP=0.0);
-    ~NPC();
-
-    // Accessors and Mutators
-    void setMoveProb(double);
-    double getMoveProb();
 
-    // "Do your thing" (whatever this NPC does)
-    void dyt(bLoc);
+    // Pawn index: every live Pawn has a slot, freed slots are reused
+    int          getIdx()               { return pIdx; };
+    static Pawn* fromIdx(int);
 };
 
 #endif
@@ -4,31 +4,35 @@
 
 #include "river.hh"
 
-River::River(DIRECTION brdr)
+River::River(DIRECTION brdr, int nRows, int nCols, std::mt19937& rng)
 {
     border = brdr;
+    rRows  = nRows;
+    rCols  = nCols;
 
     switch (border) {
         case NORTH:
         case SOUTH:
             // Pick a random location along the NORTH/SOUTH border
-            setMouth(randI(0,bCols-1));
+            setMouth(randI(rng,0,rCols-1));
             break;
         case EAST:
         case WEST:
             // Pick a random location along the EAST/WEST border
-            setMouth(randI(0,bRows-1));
+            setMouth(randI(rng,0,rRows-1));
             break;
         case CENTER:
             // Pick a random location on the board (with some buffer from edges for aesthetic reasons)
-            setMouth(bLoc{bCols/2,bRows/2});
+            setMouth(bLoc{rCols/2,rRows/2});
         default:
             break;}
 }
 
-River::River(DIRECTION brdr, int indx)
+River::River(DIRECTION brdr, int indx, int nRows, int nCols)
 {
     border = brdr;
+    rRows  = nRows;
+    rCols  = nCols;
 
     setMouth(indx);
 }
@@ -61,10 +65,10 @@ void River::setMouth(int indx)
             mouth = bLoc{indx,0};
             break;
         case SOUTH:
-            mouth = bLoc{indx,bRows-1};
+            mouth = bLoc{indx,rRows-1};
             break;
         case EAST:
-            mouth = bLoc{bCols-1,indx};
+            mouth = bLoc{rCols-1,indx};
             break;
         case WEST:
             mouth = bLoc{0,indx};
@@ -16,11 +16,13 @@ class River
 private:
     DIRECTION border;
     bLoc      mouth;
+    int       rRows;    // Dimensions of the board this river flows on
+    int       rCols;
 
 public:
     // Constructor & Destructor
-    River(DIRECTION);
-    River(DIRECTION, int);
+    River(DIRECTION, int nRows, int nCols, std::mt19937& rng);
+    River(DIRECTION, int, int nRows, int nCols);
     ~River();
 
     // Methods
@@ -4,6 +4,10 @@
 
 #include "rogrand.hh"
 
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
 #ifdef _WIN32
 #include <chrono>
 #endif
@@ -23,6 +27,28 @@ namespace rogrand
     std::uniform_int_distribution<int> dist100(0, 99);
     std::uniform_int_distribution<int> dist1000(0, 999);
 
+    void setSeed(unsigned int newSeed)
+    {
+        seed = newSeed;
+        mt.seed(seed);
+    }
+
+    // SplitMix64 finalizer (good avalanche for sequential inputs)
+    static uint64_t mix64(uint64_t hh)
+    {
+        hh = (hh ^ (hh >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        hh = (hh ^ (hh >> 27)) * 0x94D049BB133111EBULL;
+        return hh ^ (hh >> 31);
+    }
+
+    unsigned int deriveSeed(SEED_STREAM strm, int keyA, int keyB)
+    {
+        uint64_t hh = mix64(seed + 0x9E3779B97F4A7C15ULL*(strm+1));
+        hh = mix64(hh ^ (uint32_t)keyA);
+        hh = mix64(hh ^ ((uint64_t)(uint32_t)keyB << 32));
+        return (unsigned int)(hh ^ (hh >> 32));
+    }
+
     int randI10()   { return dist10(mt); }
     int randI100()  { return dist100(mt); }
     int randI1000() { return dist1000(mt); }
@@ -32,6 +58,44 @@ namespace rogrand
         std::uniform_int_distribution<int> tmpDist(iMin,iMax);
         return tmpDist(mt);
     }
+
+    int randI1000(std::mt19937& rng) { return randI(rng,0,999); }
+
+    int randI(std::mt19937& rng, int iMin, int iMax)
+    {
+        // Reject draws past the last whole multiple of the span, so every
+        // value is equally likely
+        uint64_t span  = (uint64_t)((int64_t)iMax-iMin)+1;
+        uint64_t limit = (0x100000000ULL/span)*span;
+        uint64_t draw;
+        do {
+            draw = rng(); } while (draw >= limit);
+        return (int)(iMin + (int64_t)(draw % span));
+    }
+
+    double randUnit(std::mt19937& rng)
+    {
+        // 53 random bits, the full precision of a double
+        uint64_t hi = rng() >> 5;
+        uint64_t lo = rng() >> 6;
+        return (hi*67108864.0 + lo) / 9007199254740992.0;
+    }
+
+    int randPoisson(std::mt19937& rng, double mean)
+    {
+        // Knuth's method, in steps of at most 64 so exp() doesn't underflow
+        // (a sum of Poisson draws is Poisson with the summed mean)
+        int num = 0;
+        while (mean > 0.0)
+        {
+            double step  = std::min(mean, 64.0);
+            double limit = exp(-step);
+            for (double prod=randUnit(rng); prod>limit; prod*=randUnit(rng)) {
+                num++; }
+            mean -= step;
+        }
+        return num;
+    }
 }
 
 // EOF
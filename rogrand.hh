@@ -8,18 +8,43 @@
 #include <random>
 
 namespace rogrand {
+    // Independent random streams derived from the game seed. Each system
+    // draws from its own stream so that e.g. AI decisions don't perturb
+    // world generation, and a world can be regenerated from its seed.
+    enum SEED_STREAM {
+        SEED_TERRAIN    = 0,    // Elevation noise
+        SEED_RIVER      = 1,    // River mouths and widths
+        SEED_ENTITY     = 2,    // Flora and fauna placement
+        SEED_AI         = 3,    // NPC decisions (per NPC and turn, see NPCStore::plan)
+        MAX_SEED_STREAM = 4 };
+
     // Global random number generator (TODO: remove this from global)
     extern unsigned int seed;
-    extern std::mt19937 mt;
+    extern std::mt19937 mt;     // General purpose (player spawn, textures, ...)
     extern std::uniform_int_distribution<int> dist2;
     extern std::uniform_int_distribution<int> dist10;
     extern std::uniform_int_distribution<int> dist100;
     extern std::uniform_int_distribution<int> dist1000;
 
+    // Set the game seed and reseed the global generators
+    void setSeed(unsigned int);
+
+    // Derive a sub-seed for a stream, optionally keyed by a location
+    // (e.g. board coordinates). Depends only on the game seed.
+    unsigned int deriveSeed(SEED_STREAM, int keyA=0, int keyB=0);
+
     int randI10();
     int randI100();
     int randI1000();
     int randI(int, int);
+
+    // Draw from a specific generator instead of the global one. These use
+    // only the raw mt19937 output (not std:: distributions, which differ
+    // between standard libraries), so seeded streams replay everywhere.
+    int randI1000(std::mt19937&);
+    int randI(std::mt19937&, int, int);
+    double randUnit(std::mt19937&);             // [0,1)
+    int randPoisson(std::mt19937&, double mean);
 }
 
 #endif
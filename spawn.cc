@@ -0,0 +1,21 @@
+/*
+ *  Spawn Tables
+ */
+
+#include "spawn.hh"
+
+vector<SpawnRule> spawnTable = defaultSpawnTable();
+
+vector<SpawnRule> defaultSpawnTable()
+{
+    // Densities match the old per-tile rolls on sand and dirt:
+    //  cactus 2%, then 2% of the rest for fauna (90% cows, 10% gilas)
+    vector<SpawnRule> table;
+    //                    type  hostile moveProb    Deep  Shlw  Sand    Dirt    Mesa   minDist
+    table.push_back(SpawnRule{ 'c', false, 0.0, { 0.0,  0.0,  20.00,  20.00,  0.0 }, 2.0 });
+    table.push_back(SpawnRule{ 'w', false, 0.9, { 0.0,  0.0,  17.64,  17.64,  0.0 }, 2.0 });
+    table.push_back(SpawnRule{ 'g', true,  0.7, { 0.0,  0.0,   1.96,   1.96,  0.0 }, 4.0 });
+    return table;
+}
+
+// EOF
@@ -0,0 +1,37 @@
+/*
+ *  Spawn Tables
+ *
+ *  Each SpawnRule describes one NPC type: how densely it spawns on each
+ *  elevation class and how far apart spawns must be (Poisson-disk radius).
+ *  Gameboard::placeEntities draws a Poisson-distributed spawn count from
+ *  the density map and then places each spawn by dart throwing, so the
+ *  RNG cost scales with the number of spawned entities, not tiles.
+ */
+
+#ifndef __SPAWN_HH__
+#define __SPAWN_HH__
+
+#include <vector>
+
+#include "terrain.hh"
+
+using namespace std;
+
+struct SpawnRule {
+    unsigned char npcType;          // Pawn type (see Pawn::getType)
+    bool          hostile;          // NPC constructor args
+    double        moveProb;
+    double        density[numElevs];// Expected spawns per 1000 tiles, by elevation
+    double        minDist;          // Minimum distance to any other spawn (tiles)
+};
+
+// Spawn attempts per entity before giving up on it (dart throwing)
+static const int spawnTries = 30;
+
+// Active spawn table (defaults to defaultSpawnTable())
+extern vector<SpawnRule> spawnTable;
+
+vector<SpawnRule> defaultSpawnTable();
+
+#endif
+// EOF
@@ -0,0 +1,414 @@
+/*
+ *  Terrain Sampler
+ */
+
+#include "terrain.hh"
+#include "workerpool.hh"
+
+TerrainParams terrainParams;
+
+/*
+** OpenSimplex2 constants and gradients, as used by FastNoiseLite so the
+** elevation channel reproduces noise.GetNoise() exactly.
+*/
+static const int   primeX  = 501125321;
+static const int   primeY  = 1136930381;
+static const float sqrt3f  = 1.7320508075688772935274463415059f;
+static const float simG2   = (3 - sqrt3f) / 6;
+
+// 128 unit gradients, x/y interleaved: 120 at 15 degree steps then 8 at 45
+static vector<float> buildGradients()
+{
+    vector<float> grads(256);
+    for (int iG=0; iG<128; iG++)
+    {
+        double ang = (iG < 120) ? 7.5+15.0*(iG%24) : 22.5+45.0*(iG-120);
+        ang *= 3.14159265358979323846/180.0;
+        grads[2*iG]   = (float)sin(ang);
+        grads[2*iG+1] = (float)cos(ang);
+    }
+    return grads;
+}
+
+static int fastFloor(double ff) { return ff >= 0 ? (int)ff : (int)ff - 1; }
+
+// Normalizes a fractal sum to [-1,1] (gain 0.5)
+static float fractalBound(int octs)
+{
+    float amp = 0.5f;
+    float ampFractal = 1.0f;
+    for (int iO=1; iO<octs; iO++)
+    {
+        ampFractal += amp;
+        amp *= 0.5f;
+    }
+    return 1 / ampFractal;
+}
+
+// Biome by [elevation class][temperature bin][moisture bin]
+static const unsigned char biomeLUT[numElevs][climateBins][climateBins] = {
+    //  dry              normal           wet
+    { { BIOME_LAKE,     BIOME_LAKE,      BIOME_LAKE     },      // 0 Deep Water, cool
+      { BIOME_LAKE,     BIOME_LAKE,      BIOME_LAKE     },      //               mild
+      { BIOME_LAKE,     BIOME_LAKE,      BIOME_LAKE     } },    //               hot
+    { { BIOME_SHALLOWS, BIOME_MARSH,     BIOME_MARSH    },      // 1 Shallow Water
+      { BIOME_SHALLOWS, BIOME_SHALLOWS,  BIOME_MARSH    },
+      { BIOME_SHALLOWS, BIOME_SHALLOWS,  BIOME_SHALLOWS } },
+    { { BIOME_SAND,     BIOME_SAND,      BIOME_RIPARIAN },      // 2 Sand
+      { BIOME_SAND,     BIOME_SAND,      BIOME_RIPARIAN },
+      { BIOME_ALKALI,   BIOME_SAND,      BIOME_SAND     } },
+    { { BIOME_SCRUB,    BIOME_GRASS,     BIOME_GRASS    },      // 3 Dirt
+      { BIOME_DESERT,   BIOME_SCRUB,     BIOME_GRASS    },
+      { BIOME_DESERT,   BIOME_DESERT,    BIOME_SCRUB    } },
+    { { BIOME_MESA,     BIOME_PINE,      BIOME_PINE     },      // 4 Mesa
+      { BIOME_MESA,     BIOME_MESA,      BIOME_PINE     },
+      { BIOME_BADLANDS, BIOME_MESA,      BIOME_MESA     } }
+};
+
+TerrainSampler::TerrainSampler(const TerrainParams& inParams, int worldRows, int worldCols, int worldRadius)
+{
+    tp      = inParams;
+    nRows   = worldRows;
+    nCols   = worldCols;
+    nRadius = worldRadius;
+
+    // Elevation keeps the original terrain seed, climate channels are keyed off it
+    maxOcts = 1;
+    for (int iC=0; iC<MAX_CHANNEL; iC++)
+    {
+        chSeed[iC]  = deriveSeed(SEED_TERRAIN, iC);
+        chOcts[iC]  = (CH_ELEV==iC) ? (tp.noiseFractal ? tp.noiseOcts : 1) : tp.climateOcts;
+        chOcts[iC]  = std::max(1, chOcts[iC]);
+        chBound[iC] = fractalBound(chOcts[iC]);
+        maxOcts     = std::max(maxOcts, chOcts[iC]);
+    }
+
+    // Elevation classes for every integer elevation
+    elevLUT.resize(tp.elevMax+1);
+    double threshs[numElevs-1] = { tp.threshT01, tp.threshT02, tp.threshT03, tp.threshT04 };
+    for (int iE=0; iE<=tp.elevMax; iE++)
+    {
+        int eClass = 0;
+        while ( (eClass < numElevs-1) && (iE >= threshs[eClass]*tp.elevMax) ) {
+            eClass++; }
+        elevLUT[iE] = eClass;
+    }
+
+    dvsr = 2.29928*log(0.0337477*nRows);  // log fit {120,3.3},{240,4.8},{320,5.2},{480,6.6}
+    //printf("DEBUG: Elevation Adjustment Divisor = %4.2g\n",dvsr); fflush(stdout);
+}
+
+TerrainSampler::~TerrainSampler()
+{
+    // Nothing to do for now...
+}
+
+double TerrainSampler::elev(int row, int col)
+{
+    double chOut[MAX_CHANNEL];
+    noiseChannels(row, col, chOut);
+    return falloff(row, col, chOut[CH_ELEV]);
+}
+
+void TerrainSampler::noiseChannels(int row, int col, double chOut[MAX_CHANNEL])
+{
+    static const vector<float> grads = buildGradients();
+
+    // Frequency and OpenSimplex2 skew, shared by every channel
+    const double F2 = 0.5f * (1.7320508075688772935274463415059 - 1);
+    double xx = (double)row * tp.noiseFreq;
+    double yy = (double)col * tp.noiseFreq;
+    double ss = (xx + yy) * F2;
+    xx += ss;
+    yy += ss;
+
+    float sum[MAX_CHANNEL] = { 0 };
+    float amp[MAX_CHANNEL];
+    for (int iC=0; iC<MAX_CHANNEL; iC++) {
+        amp[iC] = chBound[iC]; }
+
+    for (int iO=0; iO<maxOcts; iO++)
+    {
+        // Lattice cell, offsets and falloff weights of the three simplex corners
+        int   ii = fastFloor(xx);
+        int   jj = fastFloor(yy);
+        float xi = (float)(xx - ii);
+        float yi = (float)(yy - jj);
+
+        float tt = (xi + yi) * simG2;
+        float x0 = (float)(xi - tt);
+        float y0 = (float)(yi - tt);
+        float x2 = x0 + (2 * (float)simG2 - 1);
+        float y2 = y0 + (2 * (float)simG2 - 1);
+        float x1, y1;
+        int   di, dj;
+        if (y0 > x0) { x1 = x0 + (float)simG2;       y1 = y0 + ((float)simG2 - 1); di = 0; dj = 1; }
+        else         { x1 = x0 + ((float)simG2 - 1); y1 = y0 + (float)simG2;       di = 1; dj = 0; }
+
+        float a0 = 0.5f - x0 * x0 - y0 * y0;
+        float a1 = 0.5f - x1 * x1 - y1 * y1;
+        float a2 = (float)(2 * (1 - 2 * simG2) * (1 / simG2 - 2)) * tt + ((float)(-2 * (1 - 2 * simG2) * (1 - 2 * simG2)) + a0);
+
+        // Lattice hash inputs (everything but the seed)
+        unsigned int iP = (unsigned int)ii * primeX;
+        unsigned int jP = (unsigned int)jj * primeY;
+        unsigned int h0 = iP ^ jP;
+        unsigned int h1 = (iP + di*(unsigned int)primeX) ^ (jP + dj*(unsigned int)primeY);
+        unsigned int h2 = (iP + primeX) ^ (jP + primeY);
+
+        for (int iC=0; iC<MAX_CHANNEL; iC++)
+        {
+            if (iO >= chOcts[iC]) {
+                continue; }
+
+            unsigned int seed = chSeed[iC] + iO;
+            float n0 = 0, n1 = 0, n2 = 0;
+            if (a0 > 0) {
+                unsigned int hh = (seed ^ h0) * 0x27d4eb2d;
+                hh = ((hh ^ (hh >> 15)) & (127 << 1));
+                n0 = (a0 * a0) * (a0 * a0) * (x0 * grads[hh] + y0 * grads[hh | 1]); }
+            if (a1 > 0) {
+                unsigned int hh = (seed ^ h1) * 0x27d4eb2d;
+                hh = ((hh ^ (hh >> 15)) & (127 << 1));
+                n1 = (a1 * a1) * (a1 * a1) * (x1 * grads[hh] + y1 * grads[hh | 1]); }
+            if (a2 > 0) {
+                unsigned int hh = (seed ^ h2) * 0x27d4eb2d;
+                hh = ((hh ^ (hh >> 15)) & (127 << 1));
+                n2 = (a2 * a2) * (a2 * a2) * (x2 * grads[hh] + y2 * grads[hh | 1]); }
+
+            sum[iC] += ((n0 + n1 + n2) * 99.83685446303647f) * amp[iC];
+            amp[iC] *= 0.5f;
+        }
+
+        xx *= 2.0f;
+        yy *= 2.0f;
+    }
+
+    chOut[CH_ELEV]  = ((sum[CH_ELEV]+1.0)/2.0)*tp.elevMax;
+    chOut[CH_TEMP]  =  (sum[CH_TEMP]+1.0)/2.0;
+    chOut[CH_MOIST] =  (sum[CH_MOIST]+1.0)/2.0;
+}
+
+double TerrainSampler::falloff(int row, int col, double dElev)
+{
+    /*
+    ** Use a power function to increase elevation further away from
+    ** map center to create "valley". Clamp to max elevation.
+    */
+    double dist = sqrt( pow((row-(nRows/2)),2) + pow((col-(nCols/2)),2) );
+    dElev += pow(double(dist)/double(nRadius)/dvsr,15.0);
+    dElev = min((int)dElev, tp.elevMax);
+
+    return dElev;
+}
+
+int TerrainSampler::elevClass(double dElev)
+{
+    // Elevations are whole units after the falloff clamp (erosion may leave fractions)
+    return elevLUT[std::max(0, std::min((int)dElev, tp.elevMax))];
+}
+
+int TerrainSampler::climateClass(double temp, double moist)
+{
+    int tBin = (temp  >= tp.climateHi) ? 2 : (temp  >= tp.climateLo) ? 1 : 0;
+    int mBin = (moist >= tp.climateHi) ? 2 : (moist >= tp.climateLo) ? 1 : 0;
+    return tBin*climateBins + mBin;
+}
+
+unsigned char TerrainSampler::biome(int eClass, int climate)
+{
+    return biomeLUT[eClass][climate/climateBins][climate%climateBins];
+}
+
+void forEachChunk(int rows, int cols, int chunkRows, int chunkCols,
+                  const std::function<void(const TerrainChunk&)>& fn)
+{
+    chunkRows = max(1, chunkRows);
+    chunkCols = max(1, chunkCols);
+    int cRows = (rows+chunkRows-1)/chunkRows;
+    int cCols = (cols+chunkCols-1)/chunkCols;
+    int numChunks = cRows*cCols;
+
+    // One item per chunk
+    parallelFor(numChunks, 1, [&](int lo, int hi) {
+        for (int iC=lo; iC<hi; iC++)
+        {
+            TerrainChunk chunk;
+            chunk.row0 = (iC/cCols)*chunkRows;
+            chunk.col0 = (iC%cCols)*chunkCols;
+            chunk.row1 = min(rows, chunk.row0+chunkRows);
+            chunk.col1 = min(cols, chunk.col0+chunkCols);
+            fn(chunk);
+        }
+    });
+}
+
+void erodeTerrain(vector<double>& elevF, int rows, int cols, const ErosionParams& ep)
+{
+    /*
+    ** All scratch fields are padded by one cell on every side so the stencils
+    ** need no edge branches. Padded index of [jj][ii] is (jj+1)*pc+(ii+1).
+    */
+    const int    pc   = cols+2;
+    const int    pLen = (rows+2)*pc;
+    const double tiny = 1e-9;
+
+    vector<double> totH(pLen, 0.0);     // terrain + water height
+    vector<double> water(pLen, 0.0);
+    vector<double> conc(pLen, 0.0);     // sediment per unit of water
+    vector<double> fluxN(pLen, 0.0);    // water leaving each cell, per direction
+    vector<double> fluxS(pLen, 0.0);    //  (padding stays 0, nothing leaves the map)
+    vector<double> fluxE(pLen, 0.0);
+    vector<double> fluxW(pLen, 0.0);
+    vector<double> sed(rows*cols, 0.0); // suspended sediment (unpadded)
+
+    /*
+    ** Hydraulic erosion (virtual pipes): rain, flow downhill, pick up
+    ** sediment where water moves fast and drop it where it slows down.
+    */
+    for (int iter=0; iter<ep.hydroIters; iter++)
+    {
+        for (int jj=0; jj<rows; jj++)
+        {
+            const double* hRow = &elevF[jj*cols];
+            double*       wRow = &water[(jj+1)*pc+1];
+            double*       tRow = &totH[(jj+1)*pc+1];
+            for (int ii=0; ii<cols; ii++)
+            {
+                wRow[ii] += ep.rain;
+                tRow[ii]  = hRow[ii] + wRow[ii];
+            }
+        }
+
+        // Replicate edge heights into the padding (no flow off the map)
+        for (int ii=1; ii<=cols; ii++)
+        {
+            totH[ii]             = totH[pc+ii];
+            totH[(rows+1)*pc+ii] = totH[rows*pc+ii];
+        }
+        for (int jj=0; jj<rows+2; jj++)
+        {
+            totH[jj*pc]        = totH[jj*pc+1];
+            totH[jj*pc+cols+1] = totH[jj*pc+cols];
+        }
+
+        // Outflow toward each lower neighbor, limited to the water present
+        for (int jj=0; jj<rows; jj++)
+        {
+            const int     p0 = (jj+1)*pc+1;
+            const double* tC = &totH[p0];
+            const double* tN = &totH[p0-pc];
+            const double* tS = &totH[p0+pc];
+            const double* wC = &water[p0];
+            const double* sC = &sed[jj*cols];
+            double* fN = &fluxN[p0];
+            double* fS = &fluxS[p0];
+            double* fE = &fluxE[p0];
+            double* fW = &fluxW[p0];
+            double* cC = &conc[p0];
+            for (int ii=0; ii<cols; ii++)
+            {
+                double dN = std::max(0.0, tC[ii]-tN[ii]);
+                double dS = std::max(0.0, tC[ii]-tS[ii]);
+                double dE = std::max(0.0, tC[ii]-tC[ii+1]);
+                double dW = std::max(0.0, tC[ii]-tC[ii-1]);
+                double fTot  = ep.kFlow*(dN+dS+dE+dW);
+                double scale = ep.kFlow*std::min(1.0, wC[ii]/(fTot+tiny));
+                fN[ii] = dN*scale;
+                fS[ii] = dS*scale;
+                fE[ii] = dE*scale;
+                fW[ii] = dW*scale;
+                cC[ii] = sC[ii]/(wC[ii]+tiny);
+            }
+        }
+
+        // Move water and sediment, then erode or deposit toward capacity
+        for (int jj=0; jj<rows; jj++)
+        {
+            const int p0 = (jj+1)*pc+1;
+            const double* fN = &fluxN[p0];
+            const double* fS = &fluxS[p0];
+            const double* fE = &fluxE[p0];
+            const double* fW = &fluxW[p0];
+            const double* cC = &conc[p0];
+            double* wC = &water[p0];
+            double* hC = &elevF[jj*cols];
+            double* sC = &sed[jj*cols];
+            for (int ii=0; ii<cols; ii++)
+            {
+                // Neighbors' flux toward this cell is their flux in the opposite direction
+                double fOut = fN[ii] + fS[ii] + fE[ii] + fW[ii];
+                double fIn  = fS[ii-pc] + fN[ii+pc] + fE[ii-1] + fW[ii+1];
+                double sIn  = fS[ii-pc]*cC[ii-pc] + fN[ii+pc]*cC[ii+pc] +
+                              fE[ii-1]*cC[ii-1]   + fW[ii+1]*cC[ii+1];
+                double sNew = sC[ii] - fOut*cC[ii] + sIn;
+
+                double capacity = ep.kCapacity*0.5*(fOut+fIn);
+                double excess   = capacity - sNew;
+                double amount   = ep.kErode*std::max(0.0, excess) + ep.kDeposit*std::min(0.0, excess);
+                amount = std::min(amount, hC[ii]);
+
+                hC[ii] -= amount;
+                sC[ii]  = sNew + amount;
+                wC[ii]  = (wC[ii] - fOut + fIn)*(1.0-ep.kEvaporate);
+            }
+        }
+    }
+
+    // Whatever is still suspended settles where it is
+    for (int kk=0; kk<rows*cols; kk++) {
+        elevF[kk] += sed[kk]; }
+
+    /*
+    ** Thermal erosion: slopes steeper than the talus collapse toward their
+    ** neighbors. Jacobi update from a padded copy keeps it order independent.
+    */
+    vector<double>& prevH = totH;
+    for (int iter=0; iter<ep.thermalIters; iter++)
+    {
+        for (int jj=0; jj<rows+2; jj++)
+        {
+            int jSrc = std::max(0, std::min(jj-1, rows-1));
+            for (int ii=0; ii<cols+2; ii++) {
+                prevH[jj*pc+ii] = elevF[jSrc*cols+std::max(0, std::min(ii-1, cols-1))]; }
+        }
+
+        for (int jj=0; jj<rows; jj++)
+        {
+            const double* hC = &prevH[(jj+1)*pc+1];
+            const double* hN = hC-pc;
+            const double* hS = hC+pc;
+            double*       hOut = &elevF[jj*cols];
+            for (int ii=0; ii<cols; ii++)
+            {
+                double cc = hC[ii];
+                double dd = std::max(0.0, hN[ii]  -cc-ep.talus) - std::max(0.0, cc-hN[ii]  -ep.talus)
+                          + std::max(0.0, hS[ii]  -cc-ep.talus) - std::max(0.0, cc-hS[ii]  -ep.talus)
+                          + std::max(0.0, hC[ii+1]-cc-ep.talus) - std::max(0.0, cc-hC[ii+1]-ep.talus)
+                          + std::max(0.0, hC[ii-1]-cc-ep.talus) - std::max(0.0, cc-hC[ii-1]-ep.talus);
+                hOut[ii] = cc + ep.thermalRate*dd;
+            }
+        }
+    }
+}
+
+void createOverview(const TerrainParams& tp, int rows, int cols, int radius, int stride,
+                    vector<unsigned char>& img, int& oRows, int& oCols)
+{
+    TerrainSampler sampler(tp, rows, cols, radius);
+
+    stride = max(1, stride);
+    oRows  = (rows+stride-1)/stride;
+    oCols  = (cols+stride-1)/stride;
+    img.resize(oRows*oCols);
+
+    for (int jj=0; jj<oRows; jj++)
+    {
+        for (int ii=0; ii<oCols; ii++)
+        {
+            img[jj*oCols+ii] = sampler.elevClass(sampler.elev(jj*stride, ii*stride));
+        }
+    }
+}
+
+// EOF
@@ -0,0 +1,165 @@
+/*
+ *  Terrain Sampler
+ *
+ *  Evaluates elevation noise plus the valley falloff at any world location
+ *  without touching Tiles. Everything is a function of world coordinates
+ *  (the valley is centered on the world, not on the board being generated),
+ *  so any chunk of the world can be generated on its own, in any order or
+ *  in parallel, and its edges line up with its neighbors.
+ *  Gameboard::stageNoise samples every tile, createOverview samples at a
+ *  coarse stride for world maps/minimaps.
+ *
+ *  Elevation, temperature and moisture come out of one fused OpenSimplex2
+ *  fractal pass: the channels share the coordinate skew, lattice cell,
+ *  falloff weights and lattice hash, and only differ in seed and octave
+ *  count. The elevation channel matches FastNoiseLite's OpenSimplex2 bit for bit.
+ */
+
+#ifndef __TERRAIN_HH__
+#define __TERRAIN_HH__
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+
+#include "rogrand.hh"
+
+using namespace std;
+using namespace rogrand;
+
+// Number of elevation classes (0 Deep Water ... 4 Mesa)
+static const int numElevs = 5;
+
+// Noise channels evaluated together by TerrainSampler::noiseChannels
+enum NOISE_CHANNEL {CH_ELEV, CH_TEMP, CH_MOIST, MAX_CHANNEL};
+
+// Temperature and moisture are each split into this many bins
+static const int climateBins = 3;
+
+// Biomes (stored as the Tile terrain type)
+enum BIOME {
+    BIOME_LAKE     = 'l',
+    BIOME_SHALLOWS = 'f',
+    BIOME_MARSH    = 'h',
+    BIOME_ALKALI   = 'a',
+    BIOME_SAND     = 's',
+    BIOME_RIPARIAN = 'r',
+    BIOME_DESERT   = 'd',
+    BIOME_SCRUB    = 'b',
+    BIOME_GRASS    = 'g',
+    BIOME_BADLANDS = 'x',
+    BIOME_MESA     = 'm',
+    BIOME_PINE     = 'p'
+};
+
+// Erosion params (optional post-process on the raw elevation field)
+struct ErosionParams {
+    bool   enabled      = false;    // Run erosion before thresholding
+    int    hydroIters   = 60;       // Hydraulic (rainfall) iterations
+    double rain         = 0.5;      // Water added per cell per iteration
+    double kFlow        = 0.2;      // Fraction of a height difference that flows per iteration
+    double kCapacity    = 2.0;      // Sediment carried per unit of water flow
+    double kErode       = 0.3;      // Rate of picking up sediment below capacity
+    double kDeposit     = 0.3;      // Rate of dropping sediment above capacity
+    double kEvaporate   = 0.02;     // Fraction of water lost per iteration
+    int    thermalIters = 20;       // Thermal (slope collapse) iterations
+    double talus        = 40.0;     // Height difference neighbors can hold without slumping
+    double thermalRate  = 0.2;      // Fraction of excess moved per iteration (<= 0.25)
+};
+
+// Terrain params
+struct TerrainParams {
+    float  noiseFreq = 0.06f;   // Elevation noise frequency
+    int    noiseOcts = 4;       // Elevation noise fractal octaves (only used with noiseFractal)
+    bool   noiseFractal = false;// Elevation as FBm; off keeps the single octave the valley is tuned for
+    int    elevMax   = 1000;    // Maximum random elevation
+    double threshT00 = 0.000;   // Terrain threshold to be elevation 0, Deep Water
+    double threshT01 = 0.010;   // Terrain threshold to be elevation 1, Shallow Water
+    double threshT02 = 0.020;   // Terrain threshold to be elevation 2, Sand
+    double threshT03 = 0.450;   // Terrain threshold to be elevation 3, Dirt
+    double threshT04 = 0.820;   // Terrain threshold to be elevation 4, Mesa
+    int    climateOcts = 2;     // Octaves of the temperature/moisture channels
+    double climateLo = 0.42;    // Climate channel split between bins 0 and 1
+    double climateHi = 0.58;    // Climate channel split between bins 1 and 2
+    //double threshT05 = 0.820;   // Terrain threshold to be elevation 5, Grass
+    //double threshT06 = 0.940;   // Terrain threshold to be elevation 6, Forest
+    //double threshT07 = 0.960;   // Terrain threshold to be elevation 7, Mountain
+    //double threshT08 = 0.980;   // Terrain threshold to be elevation 8, Snow
+    ErosionParams erosion;
+};
+
+// Active terrain params, copied by each new Gameboard
+extern TerrainParams terrainParams;
+
+class TerrainSampler
+{
+private:
+    TerrainParams tp;
+
+    // Per channel seed, octave count and fractal amplitude normalization
+    unsigned int chSeed[MAX_CHANNEL];
+    int          chOcts[MAX_CHANNEL];
+    float        chBound[MAX_CHANNEL];
+    int          maxOcts;
+
+    // Classifier lookup tables
+    vector<unsigned char> elevLUT;      // integer elevation -> elevation class
+
+    // World dimensions (the valley is centered on the world)
+    int    nRows;
+    int    nCols;
+    int    nRadius;
+    double dvsr;    // Valley falloff divisor
+
+public:
+    // Constructor & Destructor
+    TerrainSampler(const TerrainParams&, int worldRows, int worldCols, int worldRadius);
+    ~TerrainSampler();
+
+    // Raw elevation [0,elevMax] at a world location (noise + valley falloff)
+    double elev(int row, int col);
+
+    // All noise channels at a world location in one pass: chOut[CH_ELEV] is
+    // the raw noise elevation [0,elevMax], temperature and moisture are [0,1]
+    void noiseChannels(int row, int col, double chOut[MAX_CHANNEL]);
+
+    // World-level valley falloff, applied to the elevation channel as a separate pass
+    double falloff(int row, int col, double dElev);
+
+    // Elevation class (0-4) for a raw elevation
+    int elevClass(double dElev);
+
+    // Climate bin (0 to climateBins^2-1) for a temperature and moisture
+    int climateClass(double temp, double moist);
+
+    // Biome for an elevation class and climate bin
+    unsigned char biome(int eClass, int climate);
+};
+
+// A rectangle of world tiles, rows [row0,row1) and cols [col0,col1)
+struct TerrainChunk {
+    int row0;
+    int col0;
+    int row1;
+    int col1;
+};
+
+// Call fn on every chunkRows x chunkCols chunk of a rows x cols map, spread
+// over the worker pool (see parallelFor). Only for work that gives the same
+// result whichever thread runs whichever chunk (per-tile work on world
+// coordinates).
+void forEachChunk(int rows, int cols, int chunkRows, int chunkCols,
+                  const std::function<void(const TerrainChunk&)>& fn);
+
+// Erode a raw elevation field (row-major, rows x cols) in place with a fixed
+// iteration budget. Every update is a 4-neighbor stencil over padded rows.
+void erodeTerrain(vector<double>& elevF, int rows, int cols, const ErosionParams&);
+
+// Sample elevation classes every `stride` tiles of a rows x cols map into
+// img (row-major, oRows x oCols). No Tiles are created.
+void createOverview(const TerrainParams&, int rows, int cols, int radius, int stride,
+                    vector<unsigned char>& img, int& oRows, int& oCols);
+
+#endif
+// EOF
@@ -3,178 +3,270 @@
  */
 
 #include "tile.hh"
+#include "pawn.hh"
 
-Tile::Tile( int x, int y, int elv )
+void TileStore::resize( int inRows, int inCols, int inElev, TILE_LAYOUT inLayout )
 {
-    elev     = elv;
-    std::fill_n(crnrElev, 4, elev); // This may not be portable... Use for loop instead?
-    terrain  = 'd';
-    occupied = false;
-    isFresh  = true;
-    tPos     = bLoc{x,y};
-//    fovPos   = tPos;
-    myPawn   = nullptr;
+    rows    = inRows;
+    cols    = inCols;
+    layout  = inLayout;
+    blkCols = (cols+blkSize-1)>>blkBits;
 
-    updateFlags();
-}
+    // Blocks are padded out to whole blocks (the padding is never addressed)
+    int numSlots = rows*cols;
+    if (LAYOUT_BLOCKS == layout) {
+        numSlots = ((rows+blkSize-1)>>blkBits)*blkCols*blkSize*blkSize; }
 
-Tile::~Tile()
-{
-    // Nothing to do for now...
+    elev.assign(numSlots, inElev);
+    terrain.assign(numSlots, 'd');
+    flags.assign(numSlots, 0);
+    nbrMask.assign(numSlots, 0);
+    occupant.assign(numSlots, -1);
+    rowWords = (cols+63)/64;
+    blocked.assign(rows*rowWords, 0);
+    blkBlocked.assign(((rows+blkSize-1)>>blkBits)*blkCols, 0);
+    dirty.assign(rows*rowWords, 0);
+
+    for (int jj=0; jj<rows; jj++) {
+        for (int ii=0; ii<cols; ii++) {
+            Tile(this, index(jj,ii)).updateFlags(); }
+    }
 }
 
-void Tile::updateFlags()
+TileStore TileStore::snapshot(int row0, int col0, int nRows, int nCols) const
 {
-    if (myPawn!=nullptr) {
-        if (!myPawn->getPlayer()) { // Allows NPCs to target player
-            occupied = true;
-        }
-    }
-    else {
-        occupied = false;
-    }
+    if (editDepth > 0) {
+        printf("WARNING: TileStore snapshot taken inside an edit batch (flags may be stale).\n"); fflush(stdout); }
 
-    // TODO: Remove magic numbers
-    switch (elev) {
-        case 0: // Deep Water
-        case 4: // Mountain
-            occupied = true;
-            break;
-        default:
-            break;
-    }
+    TileStore snap;
+    snap.rows     = rows;
+    snap.cols     = cols;
+    snap.layout   = layout;
+    snap.blkCols  = blkCols;
+    snap.rowWords = rowWords;
 
-    isFresh=true;
-}
+    // Element ranges of the region. A bitboard row read (rowBits) may also
+    // read the word after the region's last one.
+    int row1 = row0+nRows;
+    int col1 = col0+nCols;
+    int wLo  = col0>>6;
+    int wHi  = std::min(rowWords-1, ((col1-1)>>6)+1);
+    int bLo  = col0>>blkBits;
+    int bHi  = (col1-1)>>blkBits;
 
-void Tile::setTerrain( unsigned char terrType )
-{
-    terrain = terrType;
-    updateFlags();
-}
+    int tLo  = index(row0, col0);
+    int tHi  = index(row1-1, col1-1);
+    snap.elev.window(elev, tLo, tHi);
+    snap.terrain.window(terrain, tLo, tHi);
+    snap.flags.window(flags, tLo, tHi);
+    snap.nbrMask.window(nbrMask, tLo, tHi);
+    snap.occupant.window(occupant, tLo, tHi);
+    snap.blocked.window(blocked, row0*rowWords+wLo, (row1-1)*rowWords+wHi);
+    snap.blkBlocked.window(blkBlocked, (row0>>blkBits)*blkCols+bLo, ((row1-1)>>blkBits)*blkCols+bHi);
 
-unsigned char Tile::getTerrain()
-{
-    return terrain;
+    // Share the chunks each row of the region touches. In the rows layout a
+    // row's tiles are one index run; in the blocks layout they are spread
+    // over several blocks, but index() grows with the column, so the run
+    // from the row's first to last tile is a superset of them.
+    for (int jj=row0; jj<row1; jj++)
+    {
+        int iLo = index(jj, col0);
+        int iHi = index(jj, col1-1);
+        snap.elev.share(elev, iLo, iHi);
+        snap.terrain.share(terrain, iLo, iHi);
+        snap.flags.share(flags, iLo, iHi);
+        snap.nbrMask.share(nbrMask, iLo, iHi);
+        snap.occupant.share(occupant, iLo, iHi);
+        snap.blocked.share(blocked, jj*rowWords+wLo, jj*rowWords+wHi);
+        if ((jj == row0) || (0 == (jj & (blkSize-1)))) {
+            snap.blkBlocked.share(blkBlocked, (jj>>blkBits)*blkCols+bLo, (jj>>blkBits)*blkCols+bHi); }
+    }
+    return snap;
 }
 
-void Tile::setElev( int elv )
+int TileStore::compact()
 {
-    elev = elv;
-    std::fill_n(crnrElev, 4, elev); // This may not be portable... Use for loop instead?
-    updateFlags();
+    int numUniform = elev.compact();
+    terrain.compact();
+    flags.compact();
+    nbrMask.compact();
+    occupant.compact();
+    blocked.compact();
+    blkBlocked.compact();
+    return numUniform;
 }
 
-int Tile::getElev()
+size_t TileStore::residentBytes() const
 {
-    return elev;
+    return elev.residentBytes() + terrain.residentBytes() + flags.residentBytes() +
+           nbrMask.residentBytes() + occupant.residentBytes() + blocked.residentBytes() +
+           blkBlocked.residentBytes();
 }
 
-void Tile::setCrnr( int cnr, int cnrElv )
+size_t TileStore::denseBytes() const
 {
-    crnrElev[cnr] = cnrElv;
-    updateFlags();
+    return elev.denseBytes() + terrain.denseBytes() + flags.denseBytes() +
+           nbrMask.denseBytes() + occupant.denseBytes() + blocked.denseBytes() +
+           blkBlocked.denseBytes();
 }
 
-int Tile::getCrnr( int cnr )
+void TileStore::setDirty( int row, int col, int num, bool isDirty )
 {
-    return crnrElev[cnr];
+    uint64_t* rWords = &dirty[row*rowWords];
+    int       colEnd = col+num;
+    while (col < colEnd)
+    {
+        int      iB    = col&63;
+        int      nB    = std::min(64-iB, colEnd-col);
+        uint64_t mask  = ((nB < 64) ? ((1ULL<<nB)-1) : ~0ULL) << iB;
+        if (isDirty) {
+            rWords[col>>6] |= mask; }
+        else {
+            rWords[col>>6] &= ~mask; }
+        col += nB;
+    }
 }
 
-bLoc Tile::getPos()
+void TileStore::beginEdit()
 {
-    return tPos;
+    if (0 == editDepth++)
+    {
+        editRow0 = rows;
+        editCol0 = cols;
+        editRow1 = 0;
+        editCol1 = 0;
+    }
 }
 
-int Tile::getX()
+void TileStore::endEdit()
 {
-    return tPos.x;
+    if (0 != --editDepth) {
+        return; }
+
+    // Every tile written in the batch is dirty; recomputing an untouched dirty tile is harmless
+    for (int jj=editRow0; jj<editRow1; jj++)
+    {
+        for (int ii=editCol0; ii<editCol1; ii+=64)
+        {
+            uint64_t bits = dirtyBits(jj, ii);
+            if (editCol1-ii < 64) {
+                bits &= (1ULL<<(editCol1-ii))-1; }
+
+            for (int iB : SetBits(bits)) {
+                Tile(this, index(jj, ii+iB)).updateFlags(); }
+        }
+    }
 }
 
-int Tile::getY()
+void Tile::touch()
 {
-    return tPos.y;
+    if (0 == ts->editDepth) {
+        updateFlags();
+        return; }
+
+    ts->markDirty(idx);
+    ts->editRow0 = std::min(ts->editRow0, getY());
+    ts->editCol0 = std::min(ts->editCol0, getX());
+    ts->editRow1 = std::max(ts->editRow1, getY()+1);
+    ts->editCol1 = std::max(ts->editCol1, getX()+1);
 }
 
-void Tile::setTexture(SDL_Texture* tTxtr)
+void Tile::updateFlags()
 {
-    tileTexture = tTxtr;
-}
+    unsigned char tFlags = ts->flags[idx] & ~TF_OCCUPIED;
 
-//void Tile::setFOVPos(bLoc fPos)
-//{
-//    fovPos = fPos;
-//
-//    if (hasPawn()) {
-//        getPawn()->setFOVPos(fovPos);
-//    }
-//}
-//
-//bLoc Tile::getFOVPos()
-//{
-//    return fovPos;
-//}
-//
-//int Tile::getFOVX()
-//{
-//    return fovPos.x;
-//}
-//
-//int Tile::getFOVY()
-//{
-//    return fovPos.y;
-//}
+    int32_t occ = ts->occupant[idx];
+    if (occ >= 0) {
+        tFlags |= TF_OCCUPIED;
+    }
+    else if (occ <= OCC_PAWN) {
+        if (!Pawn::fromIdx(OCC_PAWN-occ)->getPlayer()) { // Allows NPCs to target player
+            tFlags |= TF_OCCUPIED;
+        }
+    }
 
-bool Tile::getOccupied()
-{
-    return occupied;
+    // TODO: Remove magic numbers
+    switch (ts->elev[idx]) {
+        case 0: // Deep Water
+        case 4: // Mountain
+            tFlags |= TF_OCCUPIED;
+            break;
+        default:
+            break;
+    }
+
+    ts->flags.set(idx, tFlags);
+
+    // Mirror into the bitboard and the block's blocked count
+    int       row  = getY();
+    int       col  = getX();
+    int       iW   = row*ts->rowWords + (col>>6);
+    uint64_t  bit  = 1ULL << (col&63);
+    uint64_t  word = (ts->blocked[iW] & ~bit) | ((tFlags & TF_OCCUPIED) ? bit : 0);
+    if (word != ts->blocked[iW])
+    {
+        ts->blocked.mut(iW) = word;
+        ts->blkBlocked.mut((row>>blkBits)*ts->blkCols + (col>>blkBits)) += (tFlags & TF_OCCUPIED) ? 1 : -1;
+    }
+
+    ts->markDirty(idx);
 }
 
-void Tile::setFresh()
+void Tile::setElev( int elv )
 {
-    isFresh=true;
+    if (elv == ts->elev[idx]) {  // Keep the corners autotile set
+        return; }
+
+    ts->elev.set(idx, elv);
+    ts->flags.set(idx, ts->flags[idx] & ~(0x0F*TF_CRNR));  // Corners follow the new elevation
+    touch();
 }
 
-void Tile::setFresh(bool newFresh)
+int Tile::getCrnr( int cnr )
 {
-    isFresh=newFresh;
+    // A set corner takes the elevation of its east (NE/SE) or west (SW/NW) neighbor
+    if (0 == (ts->flags[idx] & (TF_CRNR<<cnr))) {
+        return ts->elev[idx]; }
+
+    return ts->elev[ts->index(getY(), ((cnr==NE_IC) || (cnr==SE_IC)) ? getX()+1 : getX()-1)];
 }
 
-bool Tile::getFresh()
+void Tile::setCrnrMask( unsigned char cnrMask )
 {
-    return isFresh;
+    ts->flags.set(idx, (ts->flags[idx] & ~(0x0F*TF_CRNR)) | ((cnrMask & 0x0F)*TF_CRNR));
+    ts->markDirty(idx);
 }
 
-void Tile::setPawn(Pawn* inPawn)
+void Tile::setFresh(bool newFresh)
 {
-    myPawn   = inPawn;
-    updateFlags();
+    ts->setDirty(getY(), getX(), 1, newFresh);
 }
 
-Pawn* Tile::getPawn()
+void Tile::setPawn(Pawn* inPawn)
 {
-    return myPawn;
+    ts->occupant.set(idx, (nullptr != inPawn) ? OCC_PAWN-inPawn->getIdx() : OCC_NONE);
+    touch();
 }
 
-bool Tile::hasPawn()
+Pawn* Tile::getPawn()
 {
-    return (myPawn!=nullptr);
+    int32_t occ = ts->occupant[idx];
+    return (occ <= OCC_PAWN) ? Pawn::fromIdx(OCC_PAWN-occ) : nullptr;
 }
 
-void Tile::rmvPawn()
+void Tile::rmvOccupant()
 {
-    myPawn   = nullptr;
-    updateFlags();
+    ts->occupant.set(idx, OCC_NONE);
+    touch();
 }
 
 void Tile::toPrint()
 {
     printf("INFO: Tile:toPrint()\n");
-    printf("        Position  = [%2d,%2d]\n",tPos.x, tPos.y);
-//    printf("        FOV Posn  = [%2d,%2d]\n",fovPos.x, fovPos.y);
-    printf("        Elevation = %2d\n",elev);
-    printf("        Terrrain  = %c\n",terrain);
-    printf("        Occupied  = %1d\n",occupied);
+    printf("        Position  = [%2d,%2d]\n",getX(), getY());
+    printf("        Elevation = %2d\n",getElev());
+    printf("        Terrrain  = %c\n",getTerrain());
+    printf("        Occupied  = %1d\n",getOccupied());
 }
 
 // EOF
@@ -1,13 +1,34 @@
 /*
  *  Tile Class
+ *
+ *  Tile data lives in a TileStore: packed per-tile arrays owned by the
+ *  world board, 8 bytes per tile. A Tile is a lightweight handle (store +
+ *  index) passed by value, so scans over elevations or flags walk one
+ *  contiguous array instead of chasing a heap object per tile.
+ *
+ *  Tiles are stored row-major, or (LAYOUT_BLOCKS) in 16x16 blocks with the
+ *  tiles of a block in Morton (Z) order, so an 8-neighbourhood or a square
+ *  window touches a few cache lines instead of one per row. Code outside
+ *  the store only goes through index/rowOf/colOf, never idx arithmetic.
+ *
+ *  The arrays are copy-on-write (CowArray): a snapshot of a region of the
+ *  store shares the chunks covering that region, and the store copies a
+ *  chunk only on its first write after the snapshot, so snapshots stay
+ *  consistent without locks. Chunks of a
+ *  single value (open desert, the mesa rim) share one chunk per value and
+ *  are only materialised on write. A tile chunk is one 16x16 block in
+ *  LAYOUT_BLOCKS (a 256 tile run of a row otherwise).
+ *
+ *  Blocked (TF_OCCUPIED) tiles are mirrored in a bitboard, one 64-bit word
+ *  per 64 columns of a row, so passability of a run of tiles is a shift
+ *  and a mask and free tiles can be counted with popcount. Tiles changed
+ *  since the last render are tracked the same way in a dirty bitboard.
  */
 
 /*
  *  TERRAIN TYPES:
  *
- *  d   :   desert
- *  ?   :   TBD
- *  ?   :   TBD
+ *  d   :   desert (see BIOME in terrain.hh for the rest)
  *
  *
  */
@@ -15,66 +36,363 @@
 #ifndef __TILE_HH__
 #define __TILE_HH__
 
-#include <SDL2/SDL.h>
-
 #include <string>
+#include <vector>
+#include <cstdint>
 #include <algorithm>
+#include <array>
+#include <memory>
+#include <atomic>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
 
-#include "pawn.hh"
 #include "navigator.hh"
 
+using namespace std;
+
 class Pawn;
 
+// Tile occupant (TileStore::occupant): an NPC slot of the board's NPCStore
+// (>= 0), OCC_NONE, or Pawn index p stored as OCC_PAWN-p
+static const int32_t OCC_NONE = -1;
+static const int32_t OCC_PAWN = -2;
+
+// Tile flag bits (TileStore::flags), corners in the upper nibble
+enum TILE_FLAG {
+    TF_OCCUPIED = 0x01,     // Impassable terrain or a non-player Pawn
+    TF_CRNR     = 0x10 };   // Corner bits: TF_CRNR<<INTERCARDINAL, set if that
+                            // corner takes its east/west neighbor's elevation
+
+// Array split into chunks of 1<<cowBits elements. Copies share the chunks;
+// a write to a shared chunk first copies it, so copies never see each
+// other's writes. Reads of a copy are lock free from any thread, but writes
+// (and taking copies) of one array must come from a single thread.
+//
+// Uniform chunks (every element equal) all point at one shared chunk per
+// value, so they take no memory of their own until their first write. A new
+// array starts out uniform; compact() folds chunks that became uniform.
+//
+// A window (see window/share) holds only the chunks of some element ranges,
+// for snapshots of part of an array. Only shared elements may be read.
+template<typename T, int cowBits>
+class CowArray
+{
+private:
+    static const int cowSize = 1<<cowBits;
+    typedef std::array<T, cowSize> Chunk;
+
+    int num = 0;
+    int chunk0 = 0;                     // First chunk held (0 unless a window)
+    vector<shared_ptr<Chunk>> chunks;
+    vector<shared_ptr<Chunk>> uniform;  // One shared chunk per uniform value
+
+    shared_ptr<Chunk> uniformChunk(T val)
+    {
+        for (size_t iU=0; iU<uniform.size(); iU++) {
+            if ((*uniform[iU])[0] == val) {
+                return uniform[iU]; }
+        }
+        uniform.push_back(make_shared<Chunk>());
+        uniform.back()->fill(val);
+        return uniform.back();
+    }
+
+    bool isUniform(const shared_ptr<Chunk>& chunk) const
+    {
+        for (size_t iU=0; iU<uniform.size(); iU++) {
+            if (uniform[iU] == chunk) {
+                return true; }
+        }
+        return false;
+    }
+
+public:
+    void assign(int inNum, T val)
+    {
+        num = inNum;
+        chunk0 = 0;
+        uniform.clear();
+        chunks.assign((num+cowSize-1)>>cowBits, uniformChunk(val));
+    }
+
+    // Start a window of src over elements [iLo, iHi], sharing nothing yet
+    void window(const CowArray& src, int iLo, int iHi)
+    {
+        num     = src.num;
+        uniform = src.uniform;
+        chunk0  = iLo>>cowBits;
+        chunks.assign((iHi>>cowBits)-chunk0+1, nullptr);
+    }
+
+    // Share src's chunks holding elements [iLo, iHi] (inside the window)
+    void share(const CowArray& src, int iLo, int iHi)
+    {
+        for (int iC=iLo>>cowBits; iC<=(iHi>>cowBits); iC++) {
+            if (!chunks[iC-chunk0]) {
+                chunks[iC-chunk0] = src.chunks[iC-src.chunk0]; }
+        }
+    }
+
+    const T& operator[](int iE) const { return (*chunks[(iE>>cowBits)-chunk0])[iE&(cowSize-1)]; };
+
+    // Writable element, copying its chunk if it is shared (uniform or snapshot)
+    T& mut(int iE)
+    {
+        shared_ptr<Chunk>& chunk = chunks[(iE>>cowBits)-chunk0];
+        if (chunk.use_count() > 1) {
+            chunk = make_shared<Chunk>(*chunk); }
+        else {
+            std::atomic_thread_fence(std::memory_order_acquire); }  // Order after the last reader released it
+        return (*chunk)[iE&(cowSize-1)];
+    }
+
+    // Write only if the value changes (unchanged chunks stay shared)
+    void set(int iE, T val)
+    {
+        if ((*this)[iE] != val) {
+            mut(iE) = val; }
+    }
+
+    // Point chunks that hold a single value at that value's shared chunk.
+    // Returns the number of uniform chunks.
+    int compact()
+    {
+        int numUniform = 0;
+        for (size_t iC=0; iC<chunks.size(); iC++)
+        {
+            const Chunk& chunk = *chunks[iC];
+            int  len = std::min((int)cowSize, num-(int)((iC+chunk0)<<cowBits));
+            bool same = true;
+            for (int iE=1; (iE<len) && same; iE++) {
+                same = (chunk[iE] == chunk[0]); }
+
+            if (same) {
+                chunks[iC] = uniformChunk(chunk[0]);
+                numUniform++; }
+        }
+        return numUniform;
+    }
+
+    // Bytes of chunk data held by this array (each uniform value once),
+    // and the bytes a dense array would take
+    size_t residentBytes() const
+    {
+        size_t numOwn = uniform.size();
+        for (size_t iC=0; iC<chunks.size(); iC++) {
+            numOwn += !isUniform(chunks[iC]); }
+        return numOwn*sizeof(Chunk);
+    }
+    size_t denseBytes() const { return chunks.size()*sizeof(Chunk); };
+};
+
+// Tile storage layouts (see TileStore::index)
+enum TILE_LAYOUT {LAYOUT_ROWS, LAYOUT_BLOCKS, MAX_LAYOUT};
+static const char* const layoutNames[MAX_LAYOUT] = {"rows", "blocks"};
+
+// Block size of LAYOUT_BLOCKS and of the blocked counts (blkSize x blkSize tiles)
+static const int blkBits = 4;
+static const int blkSize = 1<<blkBits;
+
+// Morton code of a position within a block (row, col < blkSize): col bits
+// at the even positions, row bits at the odd ones. Also the reverse.
+static const unsigned int mortonCols = 0x55;
+static const unsigned int mortonRows = 0xAA;
+
+inline int mortonEncode(int row, int col)
+{
+#ifdef __BMI2__
+    return _pdep_u32(col, mortonCols) | _pdep_u32(row, mortonRows);
+#else
+    col = (col | (col<<2)) & 0x33;
+    col = (col | (col<<1)) & 0x55;
+    row = (row | (row<<2)) & 0x33;
+    row = (row | (row<<1)) & 0x55;
+    return col | (row<<1);
+#endif
+}
+
+inline int mortonCol(int code)
+{
+#ifdef __BMI2__
+    return _pext_u32(code, mortonCols);
+#else
+    code = code & 0x55;
+    code = (code | (code>>1)) & 0x33;
+    return (code | (code>>2)) & 0x0F;
+#endif
+}
+
+inline int mortonRow(int code) { return mortonCol(code>>1); }
+
+// Packed tile arrays (rows x cols, ordered by layout)
+struct TileStore {
+    int rows = 0;
+    int cols = 0;
+    TILE_LAYOUT layout = LAYOUT_ROWS;
+    int blkCols = 0;                    // Blocks per block row
+    CowArray<unsigned char, 2*blkBits> elev;        // Elevation class
+    CowArray<unsigned char, 2*blkBits> terrain;     // Terrain type (biome)
+    CowArray<unsigned char, 2*blkBits> flags;       // TILE_FLAG bits
+    CowArray<unsigned char, 2*blkBits> nbrMask;     // Neighbors with a different elevation (see Gameboard::autotile)
+    CowArray<int32_t, 2*blkBits>       occupant;    // Pawn or NPC on the tile (see OCC_NONE)
+    CowArray<uint64_t, 9>              blocked;     // TF_OCCUPIED bitboard, rowWords words per row
+    CowArray<uint16_t, 10>             blkBlocked;  // Blocked tiles per block (row-major blocks)
+    vector<uint64_t>                   dirty;       // Changed since last render, same layout as blocked (not shared)
+    int rowWords = 0;
+
+    void resize(int inRows, int inCols, int inElev, TILE_LAYOUT inLayout=LAYOUT_ROWS);
+
+    // Array index of tile [row,col], and back
+    int index(int row, int col) const
+    {
+        if (LAYOUT_ROWS == layout) {
+            return row*cols+col; }
+        return ((((row>>blkBits)*blkCols + (col>>blkBits)) << (2*blkBits)) |
+                mortonEncode(row&(blkSize-1), col&(blkSize-1)));
+    }
+    int rowOf(int idx) const
+    {
+        if (LAYOUT_ROWS == layout) {
+            return idx/cols; }
+        return (((idx>>(2*blkBits))/blkCols) << blkBits) | mortonRow(idx&(blkSize*blkSize-1));
+    }
+    int colOf(int idx) const
+    {
+        if (LAYOUT_ROWS == layout) {
+            return idx%cols; }
+        return (((idx>>(2*blkBits))%blkCols) << blkBits) | mortonCol(idx&(blkSize*blkSize-1));
+    }
+
+    // Copy of the rows x cols region at [row0,col0], sharing the tile and
+    // occupancy chunks that cover it with this store (see CowArray). Only
+    // that region may be read. Not dirty tracked. Take it outside an edit batch.
+    TileStore snapshot(int row0, int col0, int nRows, int nCols) const;
+
+    // Fold uniform chunks (see CowArray::compact). Returns the number of
+    // uniform tile chunks. Resident and dense bytes of the tile arrays.
+    int    compact();
+    size_t residentBytes() const;
+    size_t denseBytes() const;
+
+    // All tiles of the block holding [row,col] are blocked (blocks are
+    // blkSize x blkSize, aligned to the store, clipped at its edges)
+    bool blockBlocked(int row, int col) const
+    {
+        int rowB = row & ~(blkSize-1);
+        int colB = col & ~(blkSize-1);
+        int area = std::min(blkSize, rows-rowB)*std::min(blkSize, cols-colB);
+        return (blkBlocked[(row>>blkBits)*blkCols + (col>>blkBits)] == area);
+    }
+
+    // Bits of columns [col, col+64) of a row of a bitboard, bit 0 is col.
+    // Bits past the end of the row read as 0.
+    template<typename BITS>
+    uint64_t rowBits(const BITS& board, int row, int col) const
+    {
+        int      iW    = row*rowWords + (col>>6);
+        int      iB    = col&63;
+        uint64_t bits  = board[iW] >> iB;
+        if ((0 != iB) && ((col>>6)+1 < rowWords)) {
+            bits |= board[iW+1] << (64-iB); }
+        return bits;
+    }
+    uint64_t blockedBits(int row, int col) const {return rowBits(blocked, row, col);};
+    uint64_t dirtyBits(int row, int col) const   {return rowBits(dirty, row, col);};
+
+    // Mark one tile dirty, or set/clear the dirty bits of columns [col, col+num) of a row
+    void markDirty(int idx) {dirty[rowOf(idx)*rowWords + (colOf(idx)>>6)] |= 1ULL << (colOf(idx)&63);};
+    void setDirty(int row, int col, int num, bool isDirty);
+
+    // Edit batch (nestable): between beginEdit and endEdit tile writes only
+    // mark the tile dirty, and endEdit recomputes the flags of the dirty
+    // tiles in the touched box [editRow0,editRow1) x [editCol0,editCol1) once.
+    // Occupancy (flags and the blocked bitboard) is stale inside a batch.
+    int editDepth = 0;
+    int editRow0  = 0;
+    int editCol0  = 0;
+    int editRow1  = 0;
+    int editCol1  = 0;
+
+    void beginEdit();
+    void endEdit();
+};
+
+// Number of set bits
+inline int popCount(uint64_t bits) { return __builtin_popcountll(bits); }
+
+// Position of the k-th (from 0) set bit of a word, which must have more than k set
+inline int selectBit(uint64_t bits, int kk)
+{
+#ifdef __BMI2__
+    return __builtin_ctzll(_pdep_u64(1ULL<<kk, bits));
+#else
+    for (int iK=0; iK<kk; iK++) {
+        bits &= bits-1; }
+    return __builtin_ctzll(bits);
+#endif
+}
+
+// Positions of the set bits of a word, lowest first: for (int iB : SetBits(bits))
+class SetBits
+{
+private:
+    uint64_t bits;
+
+public:
+    struct iterator {
+        uint64_t bits;
+        int  operator*() const                    { return __builtin_ctzll(bits); };
+        iterator& operator++()                    { bits &= bits-1; return *this; };
+        bool operator!=(const iterator& rhs) const { return bits != rhs.bits; };
+    };
+
+    SetBits( uint64_t inBits ) : bits(inBits) {};
+    iterator begin() const { return iterator{bits}; };
+    iterator end() const   { return iterator{0}; };
+};
+
 class Tile
 {
 private:
-    // Member variables
-    int             elev;
-    int             crnrElev[4];
-    unsigned char   terrain;
-    bool            occupied;
-    bool            isFresh;
-    bLoc            tPos;
-//    bLoc            fovPos;
-    Pawn*           myPawn;
-
-    SDL_Texture* tileTexture;
+    TileStore* ts;
+    int        idx;
+
+    // Flags need recomputing after a write (deferred inside an edit batch)
+    void touch();
 
 public:
-    //Constuctor & Destructor
-    Tile( int, int, int );
-    ~Tile();
+    //Constuctor
+    Tile( TileStore* inStore, int inIdx ) : ts(inStore), idx(inIdx) {};
 
     // Check/evaluate tile flags
     void updateFlags();
 
     // Set Tile Terrain Type
-    void setTerrain(unsigned char);
-    unsigned char getTerrain();
+    void setTerrain(unsigned char terrType)  { ts->terrain.set(idx, terrType); touch(); };
+    unsigned char getTerrain()               { return ts->terrain[idx]; };
 
     void  setElev(int);
-    int   getElev();
-    void  setCrnr(int,int);
+    int   getElev()                          { return ts->elev[idx]; };
     int   getCrnr(int);
-    bLoc  getPos();
-    int   getX();
-    int   getY();
-//    void  setFOVPos(bLoc);
-//    bLoc  getFOVPos();
-//    int   getFOVX();
-//    int   getFOVY();
-    bool  getOccupied();
-    void  setFresh();
+    void  setCrnrMask(unsigned char);
+    void  setNbrMask(unsigned char inMask)   { ts->nbrMask.set(idx, inMask); };
+    unsigned char getNbrMask()               { return ts->nbrMask[idx]; };
+    bLoc  getPos()                           { return bLoc{getX(), getY()}; };
+    int   getX()                             { return ts->colOf(idx); };
+    int   getY()                             { return ts->rowOf(idx); };
+    bool  getOccupied()                      { return (0 != (ts->flags[idx] & TF_OCCUPIED)); };
+    void  setFresh()                         { ts->markDirty(idx); };
     void  setFresh(bool);
-    bool  getFresh();
+    bool  getFresh()                         { return (0 != (ts->dirtyBits(getY(), getX()) & 1)); };
     void  setPawn( Pawn* );
     Pawn* getPawn();
-    bool  hasPawn();
-    void  rmvPawn();
+    void  setNPC(int iN)                     { ts->occupant.set(idx, iN); touch(); };
+    int   getNPC()                           { return std::max(ts->occupant[idx], OCC_NONE); };
+    bool  hasOccupant()                      { return (ts->occupant[idx] != OCC_NONE); };
+    void  rmvOccupant();
     void  toPrint();
-
-    void  setTexture(SDL_Texture*);
-    SDL_Texture* getTexture() { return tileTexture; };
 };
 
 #endif
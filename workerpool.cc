@@ -0,0 +1,93 @@
+/*
+ *  Worker Pool
+ */
+
+#include <atomic>
+#include <algorithm>
+
+#include "workerpool.hh"
+
+WorkerPool::WorkerPool(int numWorkers)
+{
+    for (int iT=0; iT<numWorkers; iT++) {
+        threads.push_back(std::thread(&WorkerPool::loop, this)); }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        quit = true;
+    }
+    cvWork.notify_all();
+    for (size_t iT=0; iT<threads.size(); iT++) {
+        threads[iT].join(); }
+}
+
+void WorkerPool::loop()
+{
+    unsigned long seenId = 0;
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true)
+    {
+        cvWork.wait(lock, [&]() { return quit || ((jobId != seenId) && (slots > 0)); });
+        if (quit) {
+            return; }
+
+        seenId = jobId;
+        slots--;
+        busy++;
+        const std::function<void()>* fn = job;
+        lock.unlock();
+        (*fn)();
+        lock.lock();
+        if (0 == --busy) {
+            cvDone.notify_all(); }
+    }
+}
+
+void WorkerPool::run(const std::function<void()>& fn, int numHelpers)
+{
+    std::lock_guard<std::mutex> runLock(runMtx);
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        job   = &fn;
+        slots = std::min(numHelpers, size());
+        jobId++;
+    }
+    cvWork.notify_all();
+
+    fn();
+
+    std::unique_lock<std::mutex> lock(mtx);
+    slots = 0;
+    cvDone.wait(lock, [&]() { return (0 == busy); });
+    job = nullptr;
+}
+
+WorkerPool& WorkerPool::get()
+{
+    static WorkerPool pool(std::max(1, (int)std::thread::hardware_concurrency())-1);
+    return pool;
+}
+
+void parallelFor(int n, int batch, const std::function<void(int, int)>& fn)
+{
+    batch = std::max(1, batch);
+    int numBatches = (n+batch-1)/batch;
+
+    // Workers pull batch indices until none are left
+    std::atomic<int> nextBatch(0);
+    std::function<void()> worker = [&]() {
+        for (int iB=nextBatch++; iB<numBatches; iB=nextBatch++) {
+            fn(iB*batch, std::min(n, (iB+1)*batch)); }
+    };
+
+    // The calling thread works too
+    if (numBatches > 1) {
+        WorkerPool::get().run(worker, numBatches-1); }
+    else {
+        worker(); }
+}
+
+// EOF
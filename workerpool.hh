@@ -0,0 +1,61 @@
+/*
+ *  Worker Pool
+ *
+ *  Worker threads started on first use and reused by every parallel loop
+ *  (terrain stages, NPC plans), so a loop costs a wake-up rather than thread
+ *  creation, and per-thread scratch (thread_local, e.g. findPath's) survives
+ *  between loops.
+ */
+
+#ifndef __WORKERPOOL_HH__
+#define __WORKERPOOL_HH__
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+using namespace std;
+
+class WorkerPool
+{
+private:
+    std::mutex              mtx;
+    std::condition_variable cvWork;
+    std::condition_variable cvDone;
+    vector<std::thread>     threads;
+    const std::function<void()>* job = nullptr;
+    unsigned long jobId = 0;
+    int  slots = 0;         // Workers that may still join the current job
+    int  busy  = 0;         // Workers running the current job
+    bool quit  = false;
+
+    std::mutex runMtx;      // Held by run() for the whole job
+
+    void loop();
+
+public:
+    WorkerPool(int numWorkers);
+    ~WorkerPool();
+
+    int size() { return threads.size(); };
+
+    // Run fn on the calling thread and on up to numHelpers workers, and
+    // return once every copy has finished. Workers that wake too late skip
+    // the job, so fn must split its work dynamically. Jobs run one at a
+    // time: calling run() again from inside fn deadlocks.
+    void run(const std::function<void()>& fn, int numHelpers);
+
+    // The shared pool (hardware threads minus the caller)
+    static WorkerPool& get();
+};
+
+// Call fn(lo, hi) on consecutive batches [lo, hi) of the n items [0, n),
+// spread over the shared pool. Batches are handed out in order, but which
+// thread runs which batch varies, so results must not depend on it. Not
+// reentrant (see WorkerPool::run).
+void parallelFor(int n, int batch, const std::function<void(int, int)>& fn);
+
+#endif
+// EOF